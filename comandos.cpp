@@ -5,8 +5,10 @@
 #include <sys/stat.h>
 #include <stdexcept>
 #include <cstring>
+#include <cstdlib>
 #include <iomanip>
 #include <cstdint>
+#include <climits>
 #include <dirent.h>
 #include <errno.h>
 #include <omp.h>
@@ -64,11 +66,156 @@ static Parametros parsearArgumentos(int argc, char* argv[]) {
         else if (arg == "--comp-alg") {
             if (i + 1 < argc) {
                 p.algoritmoComp = argv[++i];
+                if (p.algoritmoComp == "huffman") {
+                    // Nombre histórico: es el mismo LZ77 + Huffman de deflate
+                    p.algoritmoComp = "deflate";
+                } else if (p.algoritmoComp == "fse") {
+                    p.opcionesComp.entropia = lz77_tokens::Entropy::Fse;
+                } else if (p.algoritmoComp == "max") {
+                    p.opcionesComp.entropia = lz77_tokens::Entropy::Cm;
+                }
             } else {
                 cerr << "\n Error: --comp-alg requiere un algoritmo" << endl;
                 exit(1);
             }
         }
+        else if (arg == "--level") {
+            if (i + 1 < argc) {
+                const char* valor = argv[++i];
+                char* fin = nullptr;
+                long nivel = strtol(valor, &fin, 10);
+                if (fin == valor || *fin != '\0' || nivel < LZ77::MIN_LEVEL || nivel > LZ77::MAX_LEVEL) {
+                    cerr << "\n Error: --level debe ser un número del " << LZ77::MIN_LEVEL
+                         << " al " << LZ77::MAX_LEVEL << endl;
+                    exit(1);
+                }
+                p.opcionesComp.nivel = (int)nivel;
+            } else {
+                cerr << "\n Error: --level requiere un número del " << LZ77::MIN_LEVEL
+                     << " al " << LZ77::MAX_LEVEL << endl;
+                exit(1);
+            }
+        }
+        else if (arg == "--parse") {
+            if (i + 1 < argc) {
+                string modo = argv[++i];
+                if (modo == "greedy") {
+                    p.opcionesComp.parseo = LZ77::Parse::Greedy;
+                } else if (modo == "lazy") {
+                    p.opcionesComp.parseo = LZ77::Parse::Lazy;
+                } else if (modo == "optimal") {
+                    p.opcionesComp.parseo = LZ77::Parse::Optimal;
+                } else {
+                    cerr << "\n Error: --parse solo acepta greedy, lazy u optimal" << endl;
+                    exit(1);
+                }
+            } else {
+                cerr << "\n Error: --parse requiere un modo (greedy, lazy, optimal)" << endl;
+                exit(1);
+            }
+        }
+        else if (arg == "--window") {
+            if (i + 1 < argc) {
+                // Con la opción presente el valor es obligatorio: ni texto ni 0 (ventana clásica)
+                const char* valor = argv[++i];
+                char* fin = nullptr;
+                long mib = strtol(valor, &fin, 10);
+                if (fin == valor || *fin != '\0' || mib < 1 || mib > 128) {
+                    cerr << "\n Error: --window debe ser un número de 1 a 128 (MiB)" << endl;
+                    exit(1);
+                }
+                p.opcionesComp.ventanaMiB = (int)mib;
+            } else {
+                cerr << "\n Error: --window requiere un tamaño en MiB (1 a 128)" << endl;
+                exit(1);
+            }
+        }
+        else if (arg == "--coding") {
+            if (i + 1 < argc) {
+                string modo = argv[++i];
+                if (modo == "tokens") {
+                    p.opcionesComp.codificacion = deflate_stream::Coding::Tokens;
+                } else if (modo == "bytes") {
+                    p.opcionesComp.codificacion = deflate_stream::Coding::Bytes;
+                } else {
+                    cerr << "\n Error: --coding solo acepta tokens o bytes" << endl;
+                    exit(1);
+                }
+            } else {
+                cerr << "\n Error: --coding requiere un modo (tokens, bytes)" << endl;
+                exit(1);
+            }
+        }
+        else if (arg == "--solid") {
+            if (i + 1 < argc) {
+                p.solido = argv[++i];
+                if (p.solido == "full") {
+                    p.opcionesComp.modoSolido = SolidMode::Full;
+                } else if (p.solido == "group") {
+                    p.opcionesComp.modoSolido = SolidMode::Grouped;
+                } else if (p.solido == "none") {
+                    p.opcionesComp.modoSolido = SolidMode::None;
+                } else {
+                    cerr << "\n Error: --solid solo acepta full, group o none" << endl;
+                    exit(1);
+                }
+            } else {
+                cerr << "\n Error: --solid requiere un modo (full, group, none)" << endl;
+                exit(1);
+            }
+        }
+        else if (arg == "--max-memory") {
+            if (i + 1 < argc) {
+                // Un tope de memoria mal escrito no puede quedar en "sin límite" (0)
+                const char* valor = argv[++i];
+                char* fin = nullptr;
+                long mib = strtol(valor, &fin, 10);
+                if (fin == valor || *fin != '\0' || mib < FolderCompressor::MIN_MAX_MEMORY_MIB || mib > INT_MAX) {
+                    cerr << "\n Error: --max-memory debe ser un número de MiB (mínimo "
+                         << FolderCompressor::MIN_MAX_MEMORY_MIB << ")" << endl;
+                    exit(1);
+                }
+                p.opcionesComp.memoriaMaxMiB = (int)mib;
+            } else {
+                cerr << "\n Error: --max-memory requiere un tamaño en MiB" << endl;
+                exit(1);
+            }
+        }
+        else if (arg == "--paranoid") {
+            p.opcionesComp.paranoico = true;
+        }
+        else if (arg == "--range") {
+            if (i + 1 < argc) {
+                // offset:len en bytes, en decimal
+                string rango = argv[++i];
+                size_t sep = rango.find(':');
+                bool valido = sep != string::npos && sep > 0 && sep + 1 < rango.size();
+                if (valido) {
+                    char* finOffset = nullptr;
+                    char* finLongitud = nullptr;
+                    p.rangoOffset = strtoull(rango.c_str(), &finOffset, 10);
+                    p.rangoLongitud = strtoull(rango.c_str() + sep + 1, &finLongitud, 10);
+                    valido = finOffset == rango.c_str() + sep && *finLongitud == '\0' &&
+                             rango[0] != '-' && rango[sep + 1] != '-';
+                }
+                if (!valido) {
+                    cerr << "\n Error: --range espera offset:longitud en bytes (ej: 1048576:4096)" << endl;
+                    exit(1);
+                }
+                p.rango = true;
+            } else {
+                cerr << "\n Error: --range requiere offset:longitud" << endl;
+                exit(1);
+            }
+        }
+        else if (arg == "--extract") {
+            if (i + 1 < argc) {
+                p.extraer = argv[++i];
+            } else {
+                cerr << "\n Error: --extract requiere una ruta dentro del .chupydir" << endl;
+                exit(1);
+            }
+        }
         else if (arg == "--enc-alg") {
             if (i + 1 < argc) {
                 p.algoritmoEnc = argv[++i];
@@ -166,6 +313,61 @@ static void validarLogicaParametros(const Parametros& p) {
         exit(1);
     }
 
+    // Al descomprimir el algoritmo sale del archivo, así que el valor no se valida
+    bool comprime = p.comprimir || p.comprimirYEncriptar;
+    if (comprime && p.algoritmoComp != "deflate" && p.algoritmoComp != "fse" &&
+        p.algoritmoComp != "max") {
+        cerr << "\nError: --comp-alg solo acepta deflate (o huffman), fse o max\n" << endl;
+        exit(1);
+    }
+
+    if (p.opcionesComp.entropia != lz77_tokens::Entropy::Huffman &&
+        p.opcionesComp.codificacion == deflate_stream::Coding::Bytes) {
+        cerr << "\nError: --comp-alg " << p.algoritmoComp << " requiere --coding tokens\n" << endl;
+        exit(1);
+    }
+
+    if (p.opcionesComp.nivel < LZ77::MIN_LEVEL || p.opcionesComp.nivel > LZ77::MAX_LEVEL) {
+        cerr << "\nError: --level debe estar entre " << LZ77::MIN_LEVEL
+             << " y " << LZ77::MAX_LEVEL << "\n" << endl;
+        exit(1);
+    }
+
+    if (p.opcionesComp.ventanaMiB < 0 || p.opcionesComp.ventanaMiB > 128) {
+        cerr << "\nError: --window debe estar entre 1 y 128 (MiB)\n" << endl;
+        exit(1);
+    }
+
+    if (p.rango && (!p.descomprimir || p.encriptar || p.desencriptar)) {
+        cerr << "\nError: --range solo se puede usar con -d\n" << endl;
+        exit(1);
+    }
+
+    if (!p.extraer.empty() && (!p.descomprimir || p.encriptar || p.desencriptar || p.rango)) {
+        cerr << "\nError: --extract solo se puede usar con -d (y sin --range)\n" << endl;
+        exit(1);
+    }
+
+    if (!p.solido.empty() && p.solido != "full" && p.opcionesComp.ventanaMiB > 0) {
+        cerr << "\nError: --window solo se puede usar con --solid full\n" << endl;
+        exit(1);
+    }
+
+    if (p.opcionesComp.memoriaMaxMiB < 0 ||
+        (p.opcionesComp.memoriaMaxMiB > 0 && p.opcionesComp.memoriaMaxMiB < FolderCompressor::MIN_MAX_MEMORY_MIB)) {
+        cerr << "\nError: --max-memory debe ser de al menos " << FolderCompressor::MIN_MAX_MEMORY_MIB
+             << " MiB\n" << endl;
+        exit(1);
+    }
+
+    // El modo sólido completo (explícito o por --window) comprime la carpeta entera en
+    // memoria, así que no hay presupuesto que respetar
+    if (p.opcionesComp.memoriaMaxMiB > 0 && (p.solido == "full" || p.opcionesComp.ventanaMiB > 0)) {
+        cerr << "\nError: --max-memory no se puede usar con --solid full ni con --window "
+             << "(comprimen la carpeta entera en memoria)\n" << endl;
+        exit(1);
+    }
+
     bool necesitaEncriptacion = p.encriptar || p.desencriptar || p.comprimirYEncriptar || 
                                 p.desencriptarYDescomprimir;
     
@@ -203,7 +405,22 @@ void mostrarAyuda() {
 
     cout << "  -i <archivo>     Archivo/carpeta de entrada" << endl;
     cout << "  -o <archivo>     Archivo/carpeta de salida" << endl;
-    cout << "  --comp-alg <x>   Algoritmo de compresión (deflate)" << endl;
+    cout << "  --comp-alg <x>   Algoritmo de compresión: deflate (LZ77 + Huffman; alias huffman)," << endl;
+    cout << "                   fse (LZ77 + tANS) o" << endl;
+    cout << "                   max (LZ77 + aritmético con contextos de orden 1/2; lento, mejor ratio)" << endl;
+    cout << "  --level <n>      Nivel de compresión 1-9 (1 = rápido, 9 = mejor ratio, por defecto 6)" << endl;
+    cout << "  --parse <modo>   Parseo LZ77: greedy (por defecto), lazy u optimal (más lento, mejor ratio)" << endl;
+    cout << "  --window <MiB>   Ventana LZ77 larga de 1 a 128 MiB (por defecto 32 KiB)" << endl;
+    cout << "                   En carpetas implica --solid full" << endl;
+    cout << "  --coding <modo>  Huffman sobre tokens separados (tokens, por defecto) o sobre bytes LZ77 (bytes)" << endl;
+    cout << "  --solid <modo>   Carpetas: group (por defecto, grupos de ~2 MiB por extensión en paralelo)," << endl;
+    cout << "                   full (un solo stream en memoria; con --window aprovecha repeticiones entre" << endl;
+    cout << "                   archivos lejanos) o none (cada archivo por separado)" << endl;
+    cout << "  --max-memory <n> Memoria máxima en MiB al comprimir carpetas (mínimo 32; por defecto un frame por hilo)" << endl;
+    cout << "                   (no se aplica con --solid full ni --window)" << endl;
+    cout << "  --paranoid       Al comprimir un archivo, lo descomprime completo y lo compara con el original" << endl;
+    cout << "  --range <o:n>    Con -d: extrae solo n bytes desde el byte o del original (sin descomprimir todo)" << endl;
+    cout << "  --extract <ruta> Con -d: extrae de un .chupydir solo ese archivo o carpeta (ruta relativa)" << endl;
     cout << "  --enc-alg <x>    Algoritmo de encriptación (chacha20)" << endl;
     cout << "  -k <clave>       Clave de encriptación\n" << endl;
     
@@ -286,7 +503,8 @@ void escribirArchivoConSyscalls(const string& rutaArchivo, const vector<uint8_t>
 
 // Compresion de carpetas usando folder_compressor
 // Explora la carpeta recursivamente y se obtienen todos los archivos
-void comprimirCarpeta(const string& carpetaEntrada, const string& carpetaSalida, const string& algoritmo) {
+void comprimirCarpeta(const string& carpetaEntrada, const string& carpetaSalida, const string& algoritmo,
+                      const OpcionesCompresion& opciones) {
     auto inicioCompresion = chrono::high_resolution_clock::now();
     
     cout << "Comprimiendo carpeta: " << carpetaEntrada << " -> " << carpetaSalida << endl;
@@ -296,7 +514,16 @@ void comprimirCarpeta(const string& carpetaEntrada, const string& carpetaSalida,
         salidaFinal += ".chupydir";
     }
     
-    FolderCompressor::compressFolder(carpetaEntrada, salidaFinal);
+    // --window necesita un único stream: sin --solid explícito pasa a full (con --solid
+    // group/none ya se rechazó al validar)
+    OpcionesCompresion efectivas = opciones;
+    if (efectivas.ventanaMiB > 0 && efectivas.modoSolido != SolidMode::Full) {
+        cout << "Aviso: --window implica --solid full (un único stream en memoria, sin grupos;"
+             << " --extract tendrá que decodificar todo)" << endl;
+        efectivas.modoSolido = SolidMode::Full;
+    }
+
+    FolderCompressor::compressFolder(carpetaEntrada, salidaFinal, efectivas);
     
     // Obtener tamaño del archivo comprimido
     struct stat fileStat;
@@ -417,11 +644,11 @@ void ejecutarOperacion(const Parametros& params) {
             if (esDirectorio) {
                 // comprimirCarpeta añade .chupydir automáticamente
                 archivoTemp = params.salida + "_temp";
-                comprimirCarpeta(params.entrada, archivoTemp, params.algoritmoComp);
+                comprimirCarpeta(params.entrada, archivoTemp, params.algoritmoComp, params.opcionesComp);
                 archivoTemp += ".chupydir"; // El archivo real tendrá esta extensión
             } else {
                 archivoTemp = params.salida + ".temp.chupy";
-                comprimirConDeflate(params.entrada, archivoTemp);
+                comprimirConDeflate(params.entrada, archivoTemp, params.opcionesComp);
             }
             
             encriptarArchivo(archivoTemp, params.salida, params.clave);
@@ -456,14 +683,39 @@ void ejecutarOperacion(const Parametros& params) {
         } else if (params.comprimir) {
             if (esDirectorio) {
                 cout << "Detectado: carpeta" << endl;
-                comprimirCarpeta(params.entrada, params.salida, params.algoritmoComp);
+                comprimirCarpeta(params.entrada, params.salida, params.algoritmoComp, params.opcionesComp);
             } else if (esArchivo) {
                 cout << "Detectado: archivo" << endl;
-                comprimirConDeflate(params.entrada, params.salida);
+                comprimirConDeflate(params.entrada, params.salida, params.opcionesComp);
             } else {
                 throw runtime_error("Error: Tipo de entrada no soportado");
             }
             
+        } else if (params.descomprimir && !params.extraer.empty()) {
+            if (!esCarpetaComprimida) {
+                throw runtime_error("Error: --extract solo se puede usar con archivos .chupydir");
+            }
+            cout << "Detectado: extracción parcial de carpeta comprimida (.chupydir)" << endl;
+            auto inicio = chrono::high_resolution_clock::now();
+            size_t extraidos = FolderCompressor::extractFiles(params.entrada, params.salida, params.extraer);
+            if (extraidos == 0) {
+                throw runtime_error("Error: " + params.extraer + " no está en " + params.entrada);
+            }
+            chrono::duration<double> duracion = chrono::high_resolution_clock::now() - inicio;
+            cout << "Archivos extraídos: " << extraidos << endl;
+            cout << "Tiempo: " << duracion.count() << " s " << endl;
+
+        } else if (params.descomprimir && params.rango) {
+            if (esCarpetaComprimida || !esArchivo) {
+                throw runtime_error("Error: --range solo se puede usar con archivos .chupy");
+            }
+            cout << "Detectado: rango de archivo comprimido individual" << endl;
+            auto inicio = chrono::high_resolution_clock::now();
+            vector<uint8_t> datos = leerRangoDeflate(params.entrada, params.rangoOffset, params.rangoLongitud);
+            chrono::duration<double> duracion = chrono::high_resolution_clock::now() - inicio;
+            mostrarResumenOperacion("Lectura de rango", datos.size(), duracion.count());
+            escribirArchivoConSyscalls(params.salida, datos);
+
         } else if (params.descomprimir) {
             if (esCarpetaComprimida) {
                 cout << "Detectado: archivo de carpeta comprimida (.chupydir)" << endl;
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include "likeDeflate/deflate_interface.h"
 
 using namespace std;
 
@@ -17,12 +18,20 @@ struct Parametros {
     bool desencriptarYDescomprimir = false; // Se activa con -ud para desencriptar y descomprimir
 
     string algoritmoComp;     // Nombre del algoritmo de compresión 
+    OpcionesCompresion opcionesComp; // Ajustes de compresión (--level, --parse)
     string algoritmoEnc;      // Nombre del algoritmo de encriptación
 
     string entrada;           // Ruta del archivo/ carpeta de entrada
     string salida;            // Ruta del archivo/ carpeta de salida
 
     string clave;             // Clave para encriptar
+
+    bool rango = false;       // Si el usuario escribió --range (solo con -d)
+    uint64_t rangoOffset = 0; // Primer byte del original a extraer
+    uint64_t rangoLongitud = 0; // Cantidad de bytes a extraer
+
+    string extraer;           // Ruta relativa a extraer de un .chupydir (--extract)
+    string solido;            // Modo de --solid tal como se escribió (vacío = por defecto)
 };
 
 // Lee, valida y retorna parámetros, si hay algún error, muestra el mensaje y termina el programa.
@@ -39,7 +48,8 @@ void ejecutarOperacion(const Parametros& params);
 
 // Explora carpeta con syscalls POSIX, crea contenedor con todos los archivos, y llama a likeDeflate para comprimirlo
 // como likeDeflate comprime archivos individuales, el metodo maneja las carpetas completas
-void comprimirCarpeta(const string& carpetaEntrada, const string& carpetaSalida, const string& algoritmo);
+void comprimirCarpeta(const string& carpetaEntrada, const string& carpetaSalida, const string& algoritmo,
+                      const OpcionesCompresion& opciones = OpcionesCompresion());
 
 
 // Descomprime archivo .chupy usando likeDeflate, luego extrae contenedor y recrea estructura de carpetas con syscalls 
@@ -7,7 +7,7 @@ namespace chupy {
 ChupyHeader::ChupyHeader() {
     std::memset(this, 0, sizeof(ChupyHeader));
     std::memcpy(magic, "CHUPY", 5);
-    version = 1;
+    version = VERSION_SIMPLE;
 }
 
 void ChupyHeader::setExtension(const std::string& ext) {
@@ -21,7 +21,9 @@ std::string ChupyHeader::getExtension() const {
 }
 
 bool ChupyHeader::isValid() const {
-    return std::memcmp(magic, "CHUPY", 5) == 0 && version == 1;
+    return std::memcmp(magic, "CHUPY", 5) == 0 &&
+           (version == VERSION_SIMPLE || version == VERSION_FRAMES ||
+            version == VERSION_INDEPENDENT);
 }
 
 std::vector<uint8_t> ChupyHeader::serialize() const {
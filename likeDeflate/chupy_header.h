@@ -7,11 +7,16 @@
 
 namespace chupy {
 
+// Versiones del formato .chupy
+constexpr uint16_t VERSION_SIMPLE = 1;  // header + un único stream Huffman
+constexpr uint16_t VERSION_FRAMES = 2;  // header + frames de deflate_stream (streaming)
+constexpr uint16_t VERSION_INDEPENDENT = 3;  // header + frames independientes + índice
+
 // Estructura del header del archivo .chupy
 // Total: 25 bytes
 struct ChupyHeader {
     char magic[8];           // "CHUPY\0\0\0"
-    uint16_t version;        // versión del formato (actualmente 1)
+    uint16_t version;        // versión del formato (VERSION_*)
     uint8_t ext_len;         // longitud de la extensión
     char extension[16];      // extensión original (ej: ".txt", ".jpg")
     
@@ -23,7 +28,7 @@ struct ChupyHeader {
     // Obtener extensión como string
     std::string getExtension() const;
     
-    // Validar magic number y versión
+    // Validar magic number y versión (acepta todas las versiones conocidas)
     bool isValid() const;
     
     // Serializar a bytes
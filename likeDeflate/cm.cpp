@@ -0,0 +1,341 @@
+#include "cm.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace cm {
+
+// ---------- util ----------
+
+static constexpr size_t HEADER_SIZE = 9;   // [u16 0][u8 tipo][u16 alfabeto][u32 símbolos]
+
+static void putU16(std::vector<uint8_t>& out, uint16_t v) {
+    out.push_back((uint8_t)(v & 0xFF));
+    out.push_back((uint8_t)(v >> 8));
+}
+
+static void putU32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int k = 0; k < 4; ++k) out.push_back((uint8_t)(v >> (8 * k)));
+}
+
+static uint16_t getU16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+static uint32_t getU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Bits del árbol binario para alphabet_size símbolos
+static int treeBits(uint32_t alphabet_size) {
+    int bits = 0;
+    while ((1u << bits) < alphabet_size) ++bits;
+    return bits;
+}
+
+// ---------- dominio logístico ----------
+
+// squash(d) = 4096 / (1 + e^(-d/256)) y stretch = su inversa; las probabilidades son de
+// 12 bits y el dominio estirado va de -2047 a 2047
+static int squash(int d) {
+    static const int t[33] = {1,    2,    3,    6,    10,   16,   27,   45,   73,   120,  194,
+                              310,  488,  747,  1101, 1546, 2047, 2549, 2994, 3348, 3607, 3785,
+                              3901, 3975, 4024, 4050, 4068, 4079, 4085, 4089, 4092, 4093, 4094};
+    if (d > 2047) return 4095;
+    if (d < -2047) return 1;
+    const int w = d & 127;
+    d = (d >> 7) + 16;
+    return (t[d] * (128 - w) + t[d + 1] * w + 64) >> 7;
+}
+
+struct StretchTable {
+    int16_t t[4096];
+    StretchTable() {
+        int pi = 0;
+        for (int x = -2047; x <= 2047; ++x) {
+            const int v = squash(x);
+            for (int i = pi; i <= v; ++i) t[i] = (int16_t)x;
+            pi = v + 1;
+        }
+        for (int i = pi; i < 4096; ++i) t[i] = 2047;
+    }
+};
+
+static inline int stretch(int p) {
+    static const StretchTable table;
+    return table.t[p];
+}
+
+// ---------- contadores ----------
+
+// Probabilidad de 22 bits en la parte alta y cantidad de observaciones (10 bits) en la
+// baja: la tasa de aprendizaje es 1/(n + 1.5), rápida al principio y estable después
+static constexpr uint32_t COUNTER_INIT = (1u << 31);
+static constexpr uint32_t COUNTER_LIMIT = 255;
+
+struct RateTable {
+    int32_t t[1024];
+    RateTable() {
+        for (int i = 0; i < 1024; ++i) t[i] = 16384 / (i + i + 3);
+    }
+};
+
+static inline int counterP(uint32_t c) { return (int)(c >> 20); }
+
+static inline void updateCounter(uint32_t& c, int bit) {
+    static const RateTable rate;
+    const uint32_t n = c & 1023;
+    const int64_t p = c >> 10;
+    const int64_t target = (int64_t)bit << 22;
+    const int64_t np = p + ((((target - p) >> 3) * rate.t[n]) >> 10);
+    c = ((uint32_t)np << 10) | (n < COUNTER_LIMIT ? n + 1 : n);
+}
+
+// ---------- modelo ----------
+
+static constexpr int INPUTS = 4;            // orden 0, 1, 2 y sesgo
+static constexpr int MAX_ORDER1_LOG = 22;
+static constexpr int MIN_ORDER2_LOG = 12;
+static constexpr int MAX_ORDER2_LOG = 22;
+static constexpr int MIXER_RATE = 3;
+
+// Con hash, la tabla de orden 2 crece con la entrada (unos 32 contadores por símbolo):
+// un stream chico no necesita 16 MiB de contadores y llenarlos costaría más que
+// codificarlo
+static int hashedOrder2Log(size_t count) {
+    int log = MIN_ORDER2_LOG;
+    while (log < MAX_ORDER2_LOG && (size_t(1) << log) < count * 32) ++log;
+    return log;
+}
+
+class Model {
+public:
+    Model(uint32_t alphabet_size, size_t count)
+        : bits_(treeBits(alphabet_size)),
+          order1_log_(std::min(MAX_ORDER1_LOG, 2 * bits_)),
+          order2_direct_(3 * bits_ <= MAX_ORDER2_LOG),
+          order2_log_(order2_direct_ ? 3 * bits_ : hashedOrder2Log(count)),
+          order0_(size_t(1) << bits_, COUNTER_INIT),
+          order1_(size_t(1) << order1_log_, COUNTER_INIT),
+          order2_(size_t(1) << order2_log_, COUNTER_INIT),
+          weights_((size_t)bits_ * 3 * INPUTS, 22000) {}
+
+    int bits() const { return bits_; }
+
+    // Prepara los contextos del símbolo siguiente
+    void beginSymbol() {
+        base1_ = (c1_ << bits_) & ((1u << order1_log_) - 1);
+        if (order2_direct_) base2_ = ((c2_ << bits_) | c1_) << bits_;
+        depth_ = 0;
+    }
+
+    // Probabilidad (12 bits) de que el próximo bit sea 1; node es la posición en el árbol
+    int predict(uint32_t node) {
+        p0_ = &order0_[node];
+        p1_ = &order1_[base1_ | node];
+        if (order2_direct_) {
+            p2_ = &order2_[base2_ | node];
+        } else {
+            // Con hash, cada 4 bits del símbolo caen en un bloque de 16 contadores (una
+            // línea de caché) elegido por el contexto y los bits ya codificados
+            if ((depth_ & 3) == 0) {
+                const uint32_t h = (c2_ * 0x9E3779B1u) ^ (c1_ * 0x85EBCA6Bu) ^ (node * 0xC2B2AE35u);
+                base2_ = (h >> (32 - (order2_log_ - 4))) << 4;
+                local_ = 1;
+            }
+            p2_ = &order2_[base2_ | local_];
+        }
+        x_[0] = stretch(counterP(*p0_));
+        x_[1] = stretch(counterP(*p1_));
+        x_[2] = stretch(counterP(*p2_));
+        x_[3] = 256;
+
+        // Los pesos dependen de la profundidad en el árbol y de cuánto se vio el contexto
+        // de orden 2
+        const uint32_t seen = *p2_ & 1023;
+        w_ = &weights_[((size_t)depth_ * 3 + (seen == 0 ? 0 : seen < 4 ? 1 : 2)) * INPUTS];
+        int64_t dot = 0;
+        for (int i = 0; i < INPUTS; ++i) dot += (int64_t)x_[i] * w_[i];
+        pr_ = std::min(4095, std::max(1, squash((int)(dot >> 16))));
+        return pr_;
+    }
+
+    void update(int bit) {
+        const int err = ((bit << 12) - pr_) * MIXER_RATE;
+        for (int i = 0; i < INPUTS; ++i) w_[i] += (x_[i] * err) >> 12;
+        updateCounter(*p0_, bit);
+        updateCounter(*p1_, bit);
+        updateCounter(*p2_, bit);
+        local_ = (local_ << 1) | (uint32_t)bit;
+        ++depth_;
+    }
+
+    void endSymbol(uint32_t sym) {
+        c2_ = c1_;
+        c1_ = sym;
+    }
+
+private:
+    int bits_;
+    int order1_log_;
+    bool order2_direct_;   // alfabetos chicos: (c2, c1, nodo) sin hash
+    int order2_log_;
+    std::vector<uint32_t> order0_;
+    std::vector<uint32_t> order1_;
+    std::vector<uint32_t> order2_;
+    std::vector<int32_t> weights_;
+
+    uint32_t c1_ = 0, c2_ = 0;        // símbolos anteriores
+    uint32_t base1_ = 0, base2_ = 0;
+    uint32_t local_ = 1;               // nodo dentro del bloque de 4 bits
+    int depth_ = 0;
+    uint32_t* p0_ = nullptr;
+    uint32_t* p1_ = nullptr;
+    uint32_t* p2_ = nullptr;
+    int32_t* w_ = nullptr;
+    int x_[INPUTS] = {};
+    int pr_ = 2048;
+};
+
+// ---------- coder aritmético ----------
+
+// Intervalo [x1, x2] de 32 bits; se emite el byte alto en cuanto x1 y x2 coinciden en él
+class Encoder {
+public:
+    explicit Encoder(std::vector<uint8_t>& out) : out_(out) {}
+
+    void encode(int bit, int p) {
+        const uint32_t xmid = x1_ + (uint32_t)(((uint64_t)(x2_ - x1_) * (uint32_t)p) >> 12);
+        if (bit) x2_ = xmid;
+        else     x1_ = xmid + 1;
+        while (((x1_ ^ x2_) & 0xFF000000u) == 0) {
+            out_.push_back((uint8_t)(x2_ >> 24));
+            x1_ <<= 8;
+            x2_ = (x2_ << 8) | 0xFF;
+        }
+    }
+
+    // Cualquier valor de [x1, x2] identifica el final; se escribe x1 completo
+    void flush() {
+        for (int k = 3; k >= 0; --k) out_.push_back((uint8_t)(x1_ >> (8 * k)));
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+    uint32_t x1_ = 0;
+    uint32_t x2_ = 0xFFFFFFFFu;
+};
+
+class Decoder {
+public:
+    Decoder(const uint8_t* data, size_t size) : data_(data), size_(size) {
+        for (int k = 0; k < 4; ++k) x_ = (x_ << 8) | nextByte();
+    }
+
+    int decode(int p) {
+        const uint32_t xmid = x1_ + (uint32_t)(((uint64_t)(x2_ - x1_) * (uint32_t)p) >> 12);
+        const int bit = x_ <= xmid;
+        if (bit) x2_ = xmid;
+        else     x1_ = xmid + 1;
+        while (((x1_ ^ x2_) & 0xFF000000u) == 0) {
+            x1_ <<= 8;
+            x2_ = (x2_ << 8) | 0xFF;
+            x_ = (x_ << 8) | nextByte();
+        }
+        return bit;
+    }
+
+    // true si se leyó más allá del final más de lo que el flush pudo dejar pendiente
+    bool overrun() const { return pos_ > size_ + 4; }
+
+private:
+    uint32_t nextByte() { return pos_ < size_ ? data_[pos_++] : (++pos_, 0u); }
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_ = 0;
+    uint32_t x_ = 0;
+    uint32_t x1_ = 0;
+    uint32_t x2_ = 0xFFFFFFFFu;
+};
+
+// ---------- API ----------
+
+template <typename Sym>
+std::vector<uint8_t> encodeStream(const Sym* symbols, size_t count, uint32_t alphabetSize) {
+    if (alphabetSize > 0xFFFF) throw std::runtime_error("cm: alfabeto demasiado grande");
+    if (count > UINT32_MAX) throw std::runtime_error("cm: demasiados símbolos");
+    std::vector<uint8_t> out;
+    out.reserve(HEADER_SIZE + count / 2 + 16);
+    putU16(out, 0);
+    out.push_back(STREAM_CM);
+    putU16(out, (uint16_t)alphabetSize);
+    putU32(out, (uint32_t)count);
+    if (count == 0) return out;
+
+    Model model(alphabetSize, count);
+    Encoder enc(out);
+    const int bits = model.bits();
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t sym = symbols[i];
+        if (sym >= alphabetSize) throw std::runtime_error("cm: símbolo fuera del alfabeto");
+        model.beginSymbol();
+        uint32_t node = 1;
+        for (int b = bits - 1; b >= 0; --b) {
+            const int bit = (sym >> b) & 1;
+            enc.encode(bit, model.predict(node));
+            model.update(bit);
+            node = (node << 1) | (uint32_t)bit;
+        }
+        model.endSymbol(sym);
+    }
+    enc.flush();
+    return out;
+}
+
+bool isCmStream(const uint8_t* data, size_t size) {
+    return size >= 3 && getU16(data) == 0 && data[2] == STREAM_CM;
+}
+
+size_t decodedSymbolCount(const uint8_t* data, size_t size) {
+    if (!isCmStream(data, size) || size < HEADER_SIZE) throw std::runtime_error("cm: cabecera truncada");
+    return getU32(data + 5);
+}
+
+template <typename Sym>
+size_t decodeStreamInto(const uint8_t* data, size_t size, Sym* out, size_t capacity) {
+    const size_t count = decodedSymbolCount(data, size);
+    const uint32_t alphabet_size = getU16(data + 3);
+    if (count > capacity) throw std::runtime_error("cm: la salida no cabe en el buffer");
+    if (count == 0) return 0;
+    if (alphabet_size == 0) throw std::runtime_error("cm: alfabeto vacío");
+    if ((uint64_t)alphabet_size > (uint64_t)std::numeric_limits<Sym>::max() + 1) {
+        throw std::runtime_error("cm: alfabeto demasiado grande para el tipo de símbolo");
+    }
+
+    Model model(alphabet_size, count);
+    Decoder dec(data + HEADER_SIZE, size - HEADER_SIZE);
+    const int bits = model.bits();
+    for (size_t i = 0; i < count; ++i) {
+        model.beginSymbol();
+        uint32_t node = 1;
+        for (int b = 0; b < bits; ++b) {
+            const int bit = dec.decode(model.predict(node));
+            model.update(bit);
+            node = (node << 1) | (uint32_t)bit;
+        }
+        const uint32_t sym = node - (1u << bits);
+        if (sym >= alphabet_size) throw std::runtime_error("cm: símbolo fuera del alfabeto");
+        out[i] = (Sym)sym;
+        model.endSymbol(sym);
+    }
+    if (dec.overrun()) throw std::runtime_error("cm: stream truncado");
+    return count;
+}
+
+template std::vector<uint8_t> encodeStream<uint8_t>(const uint8_t*, size_t, uint32_t);
+template std::vector<uint8_t> encodeStream<uint16_t>(const uint16_t*, size_t, uint32_t);
+template std::vector<uint8_t> encodeStream<uint32_t>(const uint32_t*, size_t, uint32_t);
+template size_t decodeStreamInto<uint8_t>(const uint8_t*, size_t, uint8_t*, size_t);
+template size_t decodeStreamInto<uint16_t>(const uint8_t*, size_t, uint16_t*, size_t);
+template size_t decodeStreamInto<uint32_t>(const uint8_t*, size_t, uint32_t*, size_t);
+
+} // namespace cm
@@ -0,0 +1,47 @@
+#ifndef CM_H
+#define CM_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Codificador aritmético binario adaptativo con mezcla de contextos (modo "max").
+//
+// Cada símbolo se codifica como un árbol binario de ceil(log2(alphabet_size)) bits,
+// del más significativo al menos. Cada bit se predice con tres modelos adaptativos:
+//   - orden 0: solo la posición en el árbol
+//   - orden 1: el símbolo anterior
+//   - orden 2: los dos símbolos anteriores (tabla con hash)
+// Un mezclador logístico combina las tres predicciones con pesos que se aprenden
+// sobre la marcha, y el coder aritmético gasta -log2(p) bits por bit, sin el
+// redondeo a bits enteros de Huffman. Nada se transmite: el decoder reconstruye los
+// mismos modelos, así que es simétrico y bastante más lento que Huffman o FSE.
+//
+// Sirve para cualquier stream de símbolos: las secciones de lz77_tokens (contexto =
+// literales/longitudes previos) o los bytes crudos de un frame (orden 1/2 clásico).
+//
+// Formato (usa el escape de alphabet_size 0 de los streams de huffman.h):
+//   [u16 0][u8 STREAM_CM][u16 alphabet_size][u32 num_symbols][bytes del coder aritmético]
+
+namespace cm {
+
+constexpr uint8_t STREAM_CM = 0x81;
+
+// Codifica count símbolos menores que alphabetSize. Instanciada para uint8_t, uint16_t
+// y uint32_t.
+template <typename Sym>
+std::vector<uint8_t> encodeStream(const Sym* symbols, size_t count, uint32_t alphabetSize);
+
+// true si data empieza con la cabecera de un stream CM
+bool isCmStream(const uint8_t* data, size_t size);
+
+// Cantidad de símbolos del stream (para dimensionar el buffer de salida)
+size_t decodedSymbolCount(const uint8_t* data, size_t size);
+
+// Decodifica en out (capacity símbolos) y devuelve cuántos escribió
+template <typename Sym>
+size_t decodeStreamInto(const uint8_t* data, size_t size, Sym* out, size_t capacity);
+
+} // namespace cm
+
+#endif
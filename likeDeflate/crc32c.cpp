@@ -0,0 +1,81 @@
+#include "crc32c.h"
+#include <cstring>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace crc32c {
+
+// Polinomio de Castagnoli reflejado
+constexpr uint32_t POLY = 0x82F63B78u;
+
+// table[k][b]: CRC de b seguido de k bytes en cero
+struct Tables {
+    uint32_t t[8][256];
+    Tables() {
+        for (uint32_t b = 0; b < 256; ++b) {
+            uint32_t c = b;
+            for (int i = 0; i < 8; ++i) c = (c >> 1) ^ (POLY & (0u - (c & 1)));
+            t[0][b] = c;
+        }
+        for (int k = 1; k < 8; ++k) {
+            for (uint32_t b = 0; b < 256; ++b) {
+                t[k][b] = (t[k - 1][b] >> 8) ^ t[0][t[k - 1][b] & 0xFF];
+            }
+        }
+    }
+};
+
+static const Tables tables;
+
+static uint32_t computeTables(const uint8_t* data, size_t size, uint32_t crc) {
+    const auto& t = tables.t;
+    crc = ~crc;
+    while (size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, 8);
+        const uint32_t lo = (uint32_t)word ^ crc;
+        const uint32_t hi = (uint32_t)(word >> 32);
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        data += 8;
+        size -= 8;
+    }
+    while (size--) crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+    return ~crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t computeSSE42(const uint8_t* data, size_t size, uint32_t crc) {
+    uint64_t c = ~crc;
+    while (size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, 8);
+        c = _mm_crc32_u64(c, word);
+        data += 8;
+        size -= 8;
+    }
+    uint32_t c32 = (uint32_t)c;
+    while (size--) c32 = _mm_crc32_u8(c32, *data++);
+    return ~c32;
+}
+#endif
+
+using ComputeFn = uint32_t (*)(const uint8_t*, size_t, uint32_t);
+
+static ComputeFn selectCompute() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) return computeSSE42;
+#endif
+    return computeTables;
+}
+
+static const ComputeFn computeFn = selectCompute();
+
+uint32_t compute(const uint8_t* data, size_t size, uint32_t crc) {
+    return computeFn(data, size, crc);
+}
+
+} // namespace crc32c
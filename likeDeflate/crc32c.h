@@ -0,0 +1,21 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstdint>
+#include <cstddef>
+
+// CRC32C (polinomio de Castagnoli, el de iSCSI/ext4) para verificar cada frame al
+// descomprimir sin tener que rehacer la compresión.
+//
+// En x86-64 con SSE4.2 se usa la instrucción crc32 (8 bytes por instrucción); si no,
+// una versión por tablas que procesa 8 bytes por vuelta (slicing-by-8). Ambas dan el
+// mismo resultado; la elección se hace una vez al inicio según la CPU.
+
+namespace crc32c {
+
+// CRC32C de data; crc permite encadenar: crc32c(b, nb, crc32c(a, na)) == crc32c(a+b)
+uint32_t compute(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+} // namespace crc32c
+
+#endif
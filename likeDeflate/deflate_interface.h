@@ -2,9 +2,50 @@
 #define DEFLATE_INTERFACE_H
 
 #include <string>
+#include <vector>
+#include <cstdint>
+#include "lz77.h"
+#include "deflate_stream.h"
+
+// Cómo se agrupan los archivos de una carpeta antes de comprimir
+enum class SolidMode : uint8_t {
+    Full,     // un único stream con todos los archivos en memoria; se decodifica entero
+    Grouped,  // grupos de ~2 MiB ordenados por extensión, comprimidos en paralelo
+    None,     // cada archivo en sus propios frames: extracción más barata
+};
+
+// Opciones de compresión que llegan desde la línea de comandos
+struct OpcionesCompresion {
+    int nivel = LZ77::DEFAULT_LEVEL;   // --level (1 = rápido, 9 = mejor ratio)
+    LZ77::Parse parseo = LZ77::Parse::Greedy; // --parse greedy|lazy|optimal
+    int ventanaMiB = 0;                // --window (0 = ventana clásica de 32 KiB)
+    deflate_stream::Coding codificacion = deflate_stream::Coding::Tokens; // --coding tokens|bytes
+    lz77_tokens::Entropy entropia = lz77_tokens::Entropy::Huffman;       // --comp-alg deflate|fse|max
+    SolidMode modoSolido = SolidMode::Grouped; // --solid full|group|none (carpetas)
+    int memoriaMaxMiB = 0;             // --max-memory para carpetas (0 = un frame por hilo)
+    bool paranoico = false;            // --paranoid: descomprime y compara todo al terminar
+};
+
+// Traduce las opciones de la CLI a las opciones de LZ77
+inline LZ77::Options opcionesLZ77(const OpcionesCompresion& opciones) {
+    LZ77::Options lz;
+    lz.level = opciones.nivel;
+    lz.parse = opciones.parseo;
+    if (opciones.ventanaMiB > 0) {
+        // Se redondea a la potencia de 2 siguiente: 1 MiB = 2^20
+        int log = LZ77::MIN_LONG_WINDOW_LOG;
+        while (log < LZ77::MAX_LONG_WINDOW_LOG && (1 << (log - 20)) < opciones.ventanaMiB) ++log;
+        lz.window_log = log;
+    }
+    return lz;
+}
 
 // Funciones públicas para usar desde comandos.cpp temp
-void comprimirConDeflate(const std::string& archivoEntrada, const std::string& archivoSalida);
+void comprimirConDeflate(const std::string& archivoEntrada, const std::string& archivoSalida,
+                         const OpcionesCompresion& opciones = OpcionesCompresion());
 void descomprimirConDeflate(const std::string& archivoEntrada, const std::string& archivoSalida);
+// Devuelve en memoria los bytes [offset, offset + longitud) del original (recortado al
+// final). En .chupy v3 solo decodifica los frames que cubren el rango.
+std::vector<uint8_t> leerRangoDeflate(const std::string& archivoEntrada, uint64_t offset, uint64_t longitud);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,578 @@
+#include "deflate_stream.h"
+#include "huffman.h"
+#include "lz77_tokens.h"
+#include "entropy_probe.h"
+#include "cm.h"
+#include "crc32c.h"
+#include <omp.h>
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <istream>
+#include <stdexcept>
+
+namespace deflate_stream {
+
+// ---------- util ----------
+
+static void putU32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v & 0xFF);
+    p[1] = (uint8_t)((v >> 8) & 0xFF);
+    p[2] = (uint8_t)((v >> 16) & 0xFF);
+    p[3] = (uint8_t)((v >> 24) & 0xFF);
+}
+
+static uint32_t getU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Deja en el inicio de window solo los últimos max_history bytes (la historia del siguiente frame)
+static size_t slideWindow(std::vector<uint8_t>& window, size_t max_history) {
+    size_t keep = std::min(window.size(), max_history);
+    std::memmove(window.data(), window.data() + window.size() - keep, keep);
+    window.resize(keep);
+    return keep;
+}
+
+// ---------- frames ----------
+
+// Arma un frame con checksum: cabecera, CRC32C del contenido original, window_log
+// (si window_log >= 0) y el payload
+static std::vector<uint8_t> makeFrame(uint8_t type, size_t raw_size, uint32_t crc, int window_log,
+                                      const uint8_t* payload, size_t payload_size) {
+    const size_t extra = CHECKSUM_SIZE + (window_log >= 0 ? 1 : 0);
+    std::vector<uint8_t> frame(FRAME_HEADER_SIZE + extra + payload_size);
+    frame[0] = type | FRAME_CHECKSUM;
+    putU32(frame.data() + 1, (uint32_t)raw_size);
+    putU32(frame.data() + 5, (uint32_t)(extra + payload_size));
+    putU32(frame.data() + FRAME_HEADER_SIZE, crc);
+    if (window_log >= 0) frame[FRAME_HEADER_SIZE + CHECKSUM_SIZE] = (uint8_t)window_log;
+    if (payload_size) std::memcpy(frame.data() + FRAME_HEADER_SIZE + extra, payload, payload_size);
+    return frame;
+}
+
+// Frame FRAME_STORED con raw_size bytes sin comprimir. Con window_log >= 0 (stream con
+// ventana larga) lleva FRAME_WINDOW para que el decoder no recorte la historia.
+static std::vector<uint8_t> storedFrame(const uint8_t* raw, size_t raw_size, uint32_t crc, int window_log) {
+    const uint8_t type = window_log >= 0 ? (FRAME_STORED | FRAME_WINDOW) : FRAME_STORED;
+    return makeFrame(type, raw_size, crc, window_log, raw, raw_size);
+}
+
+// Comprime window[history, history + raw_size) con window[0, history) como diccionario
+// y devuelve el frame completo (cabecera + payload). lz77_bytes acumula el tamaño
+// intermedio para las estadísticas.
+static std::vector<uint8_t> encodeFrame(const uint8_t* window, size_t history, size_t raw_size,
+                                        const LZ77::Options& options, Coding coding,
+                                        lz77_tokens::Entropy entropy, uint64_t& lz77_bytes) {
+    const LZ77::Format format = LZ77::formatFor(options);
+    const uint8_t* raw = window + history;
+    const uint32_t crc = crc32c::compute(raw, raw_size);
+    // Ventana que declaran todos los frames de un stream con ventana larga
+    const int stream_window_log = (format == LZ77::Format::Wide) ? options.window_log : -1;
+
+    // Lo que parece incompresible (JPEG, PNG, zip...) se guarda tal cual sin pasar por
+    // LZ77. Con ventana larga no se muestrea: la muestra no ve repeticiones lejanas.
+    if (format == LZ77::Format::Classic && entropy_probe::looksIncompressible(raw, raw_size)) {
+        lz77_bytes += raw_size;
+        return storedFrame(raw, raw_size, crc, stream_window_log);
+    }
+
+    auto lz77 = LZ77::compressWithDictionary(window, history + raw_size, history, options);
+
+    std::vector<uint8_t> payload;
+    uint8_t type;
+    if (coding == Coding::Tokens) {
+        type = FRAME_TOKENS_HUFFMAN;
+        payload = lz77_tokens::encode(lz77.data(), lz77.size(), format, entropy);
+    } else {
+        type = (format == LZ77::Format::Wide) ? FRAME_LZ77_WIDE_HUFFMAN : FRAME_LZ77_HUFFMAN;
+        payload = huff::encodeHuffmanStreamBlocked(lz77.data(), lz77.size(), 256, 15);
+    }
+
+    // En modo max también se prueba el modelo de contexto sobre los bytes crudos: en
+    // texto con pocas repeticiones largas el orden 2 le gana a LZ77
+    if (entropy == lz77_tokens::Entropy::Cm) {
+        auto raw_cm = cm::encodeStream(raw, raw_size, 256);
+        if (raw_cm.size() <= payload.size()) {
+            type = FRAME_CM_BYTES;
+            payload = std::move(raw_cm);
+        }
+    }
+
+    // Los tipos con LZ77, salvo el original, llevan el window_log al inicio del payload;
+    // FRAME_CM_BYTES solo si el stream tiene ventana larga (con FRAME_WINDOW)
+    int window_log = -1;
+    if (type == FRAME_CM_BYTES) {
+        window_log = stream_window_log;
+        if (window_log >= 0) type |= FRAME_WINDOW;
+    } else if (type != FRAME_LZ77_HUFFMAN) {
+        window_log = std::max(options.window_log, LZ77::DEFAULT_WINDOW_LOG);
+    }
+    const size_t extra = window_log >= 0 ? 1 : 0;
+    if (payload.size() + extra >= raw_size) {
+        // El probe no lo detectó pero comprimido no es más chico: nunca expandir
+        lz77_bytes += raw_size;
+        return storedFrame(raw, raw_size, crc, stream_window_log);
+    }
+    lz77_bytes += lz77.size();
+
+    return makeFrame(type, raw_size, crc, window_log, payload.data(), payload.size());
+}
+
+static void checkFrameType(uint8_t type) {
+    type &= ~FRAME_CHECKSUM;
+    if (type & FRAME_WINDOW) {
+        type &= ~FRAME_WINDOW;
+        if (type != FRAME_STORED && type != FRAME_CM_BYTES) {
+            throw std::runtime_error("deflate_stream: tipo de frame desconocido");
+        }
+    }
+    if (type != FRAME_LZ77_HUFFMAN && type != FRAME_LZ77_WIDE_HUFFMAN && type != FRAME_TOKENS_HUFFMAN &&
+        type != FRAME_STORED && type != FRAME_CM_BYTES) {
+        throw std::runtime_error("deflate_stream: tipo de frame desconocido");
+    }
+}
+
+// Valida la cabecera de un frame (sin FRAME_END) y devuelve su tipo
+static uint8_t checkFrameHeader(const uint8_t* p, uint32_t& raw_size, uint32_t& comp_size) {
+    const uint8_t type = p[0];
+    checkFrameType(type);
+    raw_size = getU32(p + 1);
+    comp_size = getU32(p + 5);
+    if (raw_size > MAX_FRAME_SIZE || comp_size > MAX_FRAME_SIZE) {
+        throw std::runtime_error("deflate_stream: frame demasiado grande o corrupto");
+    }
+    const size_t extra = ((type & FRAME_CHECKSUM) ? CHECKSUM_SIZE : 0) + ((type & FRAME_WINDOW) ? 1 : 0);
+    if ((type & ~(FRAME_CHECKSUM | FRAME_WINDOW)) == FRAME_STORED && comp_size != raw_size + extra) {
+        throw std::runtime_error("deflate_stream: frame sin comprimir con tamaño inválido");
+    }
+    return type;
+}
+
+// Decodifica el payload (sin checksum) de un frame en window[history, history + raw_size),
+// con window[0, history) como historia. history_max crece con la ventana del frame.
+static size_t decodePayload(uint8_t type, const uint8_t* payload, size_t payload_size,
+                              uint8_t* window, size_t history, size_t raw_size, size_t& history_max) {
+    const bool flagged = (type & FRAME_WINDOW) != 0;
+    type &= ~FRAME_WINDOW;
+    if (flagged || (type != FRAME_LZ77_HUFFMAN && type != FRAME_STORED && type != FRAME_CM_BYTES)) {
+        if (payload_size < 1) throw std::runtime_error("deflate_stream: frame truncado");
+        const int window_log = payload[0];
+        const bool long_window = window_log >= LZ77::MIN_LONG_WINDOW_LOG && window_log <= LZ77::MAX_LONG_WINDOW_LOG;
+        const bool classic_window = !flagged && window_log == LZ77::DEFAULT_WINDOW_LOG && type == FRAME_TOKENS_HUFFMAN;
+        if (!long_window && !classic_window) {
+            throw std::runtime_error("deflate_stream: ventana inválida");
+        }
+        history_max = std::max(history_max, size_t(1) << window_log);
+        payload++;
+        payload_size--;
+    }
+
+    uint8_t* out = window + history;
+    if (type == FRAME_STORED) {
+        std::memcpy(out, payload, raw_size);
+        return raw_size;
+    }
+    if (type == FRAME_CM_BYTES) {
+        return cm::decodeStreamInto(payload, payload_size, out, raw_size);
+    }
+    if (type == FRAME_TOKENS_HUFFMAN) {
+        return lz77_tokens::decodeInto(payload, payload_size, out, raw_size, history);
+    }
+    std::vector<uint8_t> lz77_bytes(huff::decodedSymbolCount(payload, payload_size));
+    huff::decodeHuffmanStreamInto(payload, payload_size, lz77_bytes.data(), lz77_bytes.size());
+    const LZ77::Format format = (type == FRAME_LZ77_WIDE_HUFFMAN) ? LZ77::Format::Wide
+                                                                   : LZ77::Format::Classic;
+    return LZ77::decompressInto(lz77_bytes.data(), lz77_bytes.size(), out, raw_size, history, format);
+}
+
+// Como decodePayload, pero primero separa el CRC32C si el frame lo trae y lo verifica
+// contra lo decodificado
+static size_t decodeFrameBody(uint8_t type, const uint8_t* payload, size_t payload_size,
+                              uint8_t* window, size_t history, size_t raw_size, size_t& history_max) {
+    const bool checked = (type & FRAME_CHECKSUM) != 0;
+    uint32_t expected_crc = 0;
+    if (checked) {
+        if (payload_size < CHECKSUM_SIZE) throw std::runtime_error("deflate_stream: frame truncado");
+        expected_crc = getU32(payload);
+        payload += CHECKSUM_SIZE;
+        payload_size -= CHECKSUM_SIZE;
+    }
+
+    const size_t produced = decodePayload(type & ~FRAME_CHECKSUM, payload, payload_size, window, history,
+                                          raw_size, history_max);
+    if (checked && produced == raw_size && crc32c::compute(window + history, raw_size) != expected_crc) {
+        throw std::runtime_error("deflate_stream: el CRC32C del frame no coincide (datos corruptos)");
+    }
+    return produced;
+}
+
+// ---------- StreamCompressor ----------
+
+StreamCompressor::StreamCompressor(const LZ77::Options& options, size_t chunk_size, Coding coding,
+                                   lz77_tokens::Entropy entropy)
+    : options_(options),
+      chunk_size_(chunk_size ? chunk_size : DEFAULT_CHUNK_SIZE),
+      coding_(coding),
+      entropy_(entropy),
+      history_max_(LZ77::windowSize(options)) {}
+
+void StreamCompressor::begin(Sink sink) {
+    sink_ = std::move(sink);
+    window_.clear();
+    window_.reserve(history_max_ + chunk_size_);
+    history_ = 0;
+    bytes_in_ = lz77_bytes_ = bytes_out_ = 0;
+}
+
+void StreamCompressor::feed(const uint8_t* data, size_t size) {
+    bytes_in_ += size;
+    while (size > 0) {
+        size_t room = chunk_size_ - (window_.size() - history_);
+        size_t take = std::min(room, size);
+        window_.insert(window_.end(), data, data + take);
+        data += take;
+        size -= take;
+        if (window_.size() - history_ == chunk_size_) {
+            emitFrame();
+        }
+    }
+}
+
+void StreamCompressor::finish() {
+    if (window_.size() > history_) {
+        emitFrame();
+    }
+    uint8_t end = FRAME_END;
+    emit(&end, 1);
+}
+
+void StreamCompressor::emitFrame() {
+    const auto frame = encodeFrame(window_.data(), history_, window_.size() - history_, options_,
+                                   coding_, entropy_, lz77_bytes_);
+    emit(frame.data(), frame.size());
+    history_ = slideWindow(window_, history_max_);
+}
+
+void StreamCompressor::emit(const uint8_t* data, size_t size) {
+    bytes_out_ += size;
+    if (sink_) sink_(data, size);
+}
+
+// ---------- StreamDecompressor ----------
+
+void StreamDecompressor::begin(Sink sink) {
+    sink_ = std::move(sink);
+    pending_.clear();
+    pending_pos_ = 0;
+    window_.clear();
+    history_ = 0;
+    history_max_ = LZ77::WINDOW_SIZE;
+    done_ = false;
+    bytes_out_ = 0;
+}
+
+void StreamDecompressor::feed(const uint8_t* data, size_t size) {
+    if (done_) {
+        if (size > 0) throw std::runtime_error("deflate_stream: datos después del fin del stream");
+        return;
+    }
+    pending_.insert(pending_.end(), data, data + size);
+    while (!done_ && decodeNextFrame()) {}
+
+    // Compacta lo ya consumido para que pending_ no crezca sin límite
+    if (pending_pos_ > 0) {
+        pending_.erase(pending_.begin(), pending_.begin() + pending_pos_);
+        pending_pos_ = 0;
+    }
+}
+
+void StreamDecompressor::finish() {
+    if (!done_) throw std::runtime_error("deflate_stream: stream truncado (falta el frame final)");
+    if (pending_.size() > pending_pos_) throw std::runtime_error("deflate_stream: datos después del fin del stream");
+}
+
+// Decodifica un frame si ya está completo en pending_; devuelve false si faltan bytes
+bool StreamDecompressor::decodeNextFrame() {
+    const size_t avail = pending_.size() - pending_pos_;
+    if (avail < 1) return false;
+    const uint8_t* p = pending_.data() + pending_pos_;
+
+    if (p[0] == FRAME_END) {
+        pending_pos_ += 1;
+        done_ = true;
+        return false;
+    }
+    if (avail < FRAME_HEADER_SIZE) {
+        checkFrameType(p[0]);
+        return false;
+    }
+    uint32_t raw_size, comp_size;
+    const uint8_t type = checkFrameHeader(p, raw_size, comp_size);
+    if (avail < FRAME_HEADER_SIZE + comp_size) return false;
+
+    window_.resize(history_ + raw_size);
+    const size_t produced = decodeFrameBody(type, p + FRAME_HEADER_SIZE, comp_size, window_.data(),
+                                            history_, raw_size, history_max_);
+    pending_pos_ += FRAME_HEADER_SIZE + comp_size;
+    if (produced != raw_size) throw std::runtime_error("deflate_stream: tamaño de frame no coincide");
+
+    bytes_out_ += raw_size;
+    if (sink_) sink_(window_.data() + history_, raw_size);
+
+    history_ = slideWindow(window_, history_max_);
+    return true;
+}
+
+// ---------- frames independientes ----------
+
+std::vector<uint8_t> compressFrame(const uint8_t* data, size_t size, const LZ77::Options& options,
+                                   Coding coding, lz77_tokens::Entropy entropy, uint64_t* lz77_bytes) {
+    if (size > MAX_FRAME_SIZE) throw std::runtime_error("deflate_stream: frame demasiado grande");
+    uint64_t lz77 = 0;
+    auto frame = encodeFrame(data, 0, size, options, coding, entropy, lz77);
+    if (lz77_bytes) *lz77_bytes += lz77;
+    return frame;
+}
+
+size_t decompressFrame(const uint8_t* frame, size_t size, uint8_t* out, size_t capacity) {
+    if (size < FRAME_HEADER_SIZE) throw std::runtime_error("deflate_stream: frame truncado");
+    uint32_t raw_size, comp_size;
+    const uint8_t type = checkFrameHeader(frame, raw_size, comp_size);
+    if (FRAME_HEADER_SIZE + (size_t)comp_size != size) {
+        throw std::runtime_error("deflate_stream: tamaño de frame no coincide con el índice");
+    }
+    if (raw_size > capacity) throw std::runtime_error("deflate_stream: frame no entra en el buffer");
+    size_t history_max = 0;
+    const size_t produced = decodeFrameBody(type, frame + FRAME_HEADER_SIZE, comp_size, out, 0,
+                                            raw_size, history_max);
+    if (produced != raw_size) throw std::runtime_error("deflate_stream: tamaño de frame no coincide");
+    return raw_size;
+}
+
+// Relanza la primera excepción (en orden de frame) capturada dentro de un bucle paralelo
+static void rethrowFirst(const std::vector<std::exception_ptr>& errors) {
+    for (const auto& e : errors) {
+        if (e) std::rethrow_exception(e);
+    }
+}
+
+FramedCompressor::FramedCompressor(const LZ77::Options& options, size_t frame_size, Coding coding,
+                                   lz77_tokens::Entropy entropy, size_t batch_frames)
+    : options_(options),
+      frame_size_(std::min(frame_size ? frame_size : INDEPENDENT_FRAME_SIZE, MAX_FRAME_SIZE)),
+      coding_(coding),
+      entropy_(entropy),
+      batch_frames_(batch_frames ? batch_frames : (size_t)std::max(1, omp_get_max_threads())) {}
+
+void FramedCompressor::begin(Sink sink) {
+    sink_ = std::move(sink);
+    pending_.clear();
+    pending_.reserve(frame_size_ * batch_frames_);
+    cuts_.clear();
+    frames_.clear();
+    bytes_in_ = lz77_bytes_ = bytes_out_ = 0;
+}
+
+void FramedCompressor::feed(const uint8_t* data, size_t size) {
+    bytes_in_ += size;
+    while (size > 0) {
+        size_t take = std::min(frame_size_ - (pending_.size() - frameStart()), size);
+        pending_.insert(pending_.end(), data, data + take);
+        data += take;
+        size -= take;
+        if (pending_.size() - frameStart() == frame_size_) {
+            endFrame();
+        }
+    }
+}
+
+void FramedCompressor::endFrame() {
+    if (pending_.size() == frameStart()) return;
+    cuts_.push_back(pending_.size());
+    if (cuts_.size() == batch_frames_) {
+        flushBatch();
+    }
+}
+
+void FramedCompressor::finish() {
+    endFrame();
+    flushBatch();
+    std::vector<uint8_t> tail(1 + frames_.size() * INDEX_ENTRY_SIZE + INDEX_TRAILER_SIZE);
+    tail[0] = FRAME_END;
+    uint8_t* p = tail.data() + 1;
+    for (const auto& f : frames_) {
+        putU32(p, f.raw_size);
+        putU32(p + 4, f.comp_size);
+        p += INDEX_ENTRY_SIZE;
+    }
+    putU32(p, (uint32_t)frames_.size());
+    putU32(p + 4, INDEX_MAGIC);
+    emit(tail.data(), tail.size());
+}
+
+// Comprime en paralelo todos los frames cerrados y los emite en orden
+void FramedCompressor::flushBatch() {
+    if (cuts_.empty()) return;
+    const size_t count = cuts_.size();
+    std::vector<std::vector<uint8_t>> out(count);
+    std::vector<uint64_t> lz77(count, 0);
+    std::vector<std::exception_ptr> errors(count);
+
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < count; ++i) {
+        const size_t begin = i ? cuts_[i - 1] : 0;
+        const size_t size = cuts_[i] - begin;
+        try {
+            out[i] = encodeFrame(pending_.data() + begin, 0, size, options_, coding_, entropy_, lz77[i]);
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    }
+    rethrowFirst(errors);
+
+    for (size_t i = 0; i < count; ++i) {
+        FrameInfo info;
+        info.raw_size = (uint32_t)(cuts_[i] - (i ? cuts_[i - 1] : 0));
+        info.comp_size = (uint32_t)out[i].size();
+        info.raw_offset = frames_.empty() ? 0 : frames_.back().raw_offset + frames_.back().raw_size;
+        info.comp_offset = bytes_out_;
+        frames_.push_back(info);
+        lz77_bytes_ += lz77[i];
+        emit(out[i].data(), out[i].size());
+    }
+    pending_.clear();
+    cuts_.clear();
+}
+
+void FramedCompressor::emit(const uint8_t* data, size_t size) {
+    bytes_out_ += size;
+    if (sink_) sink_(data, size);
+}
+
+static void readAt(std::istream& in, uint64_t offset, uint8_t* out, size_t size) {
+    in.clear();
+    in.seekg((std::streamoff)offset);
+    in.read(reinterpret_cast<char*>(out), (std::streamsize)size);
+    if (!in || (size_t)in.gcount() != size) throw std::runtime_error("deflate_stream: archivo truncado");
+}
+
+std::vector<FrameInfo> readIndex(std::istream& in, uint64_t body_offset, uint64_t body_end) {
+    if (body_end < body_offset || body_end - body_offset < 1 + INDEX_TRAILER_SIZE) {
+        throw std::runtime_error("deflate_stream: índice de frames truncado");
+    }
+    const uint64_t body_size = body_end - body_offset;
+    uint8_t trailer[INDEX_TRAILER_SIZE];
+    readAt(in, body_end - INDEX_TRAILER_SIZE, trailer, INDEX_TRAILER_SIZE);
+    if (getU32(trailer + 4) != INDEX_MAGIC) {
+        throw std::runtime_error("deflate_stream: índice de frames inválido");
+    }
+    const uint64_t count = getU32(trailer);
+    const uint64_t index_size = count * INDEX_ENTRY_SIZE + INDEX_TRAILER_SIZE;
+    if (index_size + 1 > body_size) throw std::runtime_error("deflate_stream: índice de frames truncado");
+
+    // El FRAME_END va justo antes del índice
+    std::vector<uint8_t> raw(1 + count * INDEX_ENTRY_SIZE);
+    readAt(in, body_end - index_size - 1, raw.data(), raw.size());
+    if (raw[0] != FRAME_END) throw std::runtime_error("deflate_stream: índice de frames inválido");
+
+    std::vector<FrameInfo> frames(count);
+    uint64_t raw_offset = 0, comp_offset = 0;
+    for (size_t i = 0; i < count; ++i) {
+        FrameInfo& f = frames[i];
+        f.raw_size = getU32(raw.data() + 1 + i * INDEX_ENTRY_SIZE);
+        f.comp_size = getU32(raw.data() + 1 + i * INDEX_ENTRY_SIZE + 4);
+        if (f.raw_size > MAX_FRAME_SIZE || f.comp_size < FRAME_HEADER_SIZE ||
+            f.comp_size > MAX_FRAME_SIZE + FRAME_HEADER_SIZE) {
+            throw std::runtime_error("deflate_stream: índice de frames corrupto");
+        }
+        f.raw_offset = raw_offset;
+        f.comp_offset = comp_offset;
+        raw_offset += f.raw_size;
+        comp_offset += f.comp_size;
+    }
+    // Los frames tienen que ocupar exactamente el body antes del FRAME_END
+    if (comp_offset + 1 + index_size != body_size) {
+        throw std::runtime_error("deflate_stream: índice de frames no coincide con el archivo");
+    }
+    return frames;
+}
+
+uint64_t decompressFrames(std::istream& in, uint64_t body_offset, const std::vector<FrameInfo>& frames,
+                          size_t first, size_t last, const Sink& sink) {
+    const size_t batch = (size_t)std::max(1, omp_get_max_threads());
+    last = std::min(last, frames.size());
+    uint64_t produced = 0;
+    std::vector<uint8_t> packed;
+    std::vector<std::vector<uint8_t>> out(batch);
+    std::vector<std::exception_ptr> errors(batch);
+
+    for (size_t begin = first; begin < last; begin += batch) {
+        const size_t count = std::min(batch, last - begin);
+        // Los frames de un lote son contiguos: una sola lectura
+        const uint64_t from = frames[begin].comp_offset;
+        const uint64_t to = frames[begin + count - 1].comp_offset + frames[begin + count - 1].comp_size;
+        packed.resize(to - from);
+        readAt(in, body_offset + from, packed.data(), packed.size());
+
+#pragma omp parallel for schedule(dynamic)
+        for (size_t i = 0; i < count; ++i) {
+            const FrameInfo& f = frames[begin + i];
+            errors[i] = nullptr;
+            try {
+                out[i].resize(f.raw_size);
+                decompressFrame(packed.data() + (f.comp_offset - from), f.comp_size, out[i].data(), f.raw_size);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        }
+        rethrowFirst(errors);
+
+        for (size_t i = 0; i < count; ++i) {
+            produced += out[i].size();
+            if (sink) sink(out[i].data(), out[i].size());
+        }
+    }
+    return produced;
+}
+
+uint64_t decompressFramed(std::istream& in, uint64_t body_offset, uint64_t body_end, const Sink& sink) {
+    const auto frames = readIndex(in, body_offset, body_end);
+    return decompressFrames(in, body_offset, frames, 0, frames.size(), sink);
+}
+
+void coveringFrames(const std::vector<FrameInfo>& frames, uint64_t offset, uint64_t end,
+                    size_t& first, size_t& last) {
+    // Primer frame que termina después de offset y primero que empieza en end o después
+    auto by_end = [](const FrameInfo& f, uint64_t pos) { return f.raw_offset + f.raw_size <= pos; };
+    auto by_start = [](const FrameInfo& f, uint64_t pos) { return f.raw_offset < pos; };
+    first = std::lower_bound(frames.begin(), frames.end(), offset, by_end) - frames.begin();
+    last = std::lower_bound(frames.begin(), frames.end(), end, by_start) - frames.begin();
+}
+
+std::vector<uint8_t> decompressRange(std::istream& in, uint64_t body_offset, uint64_t body_end,
+                                     uint64_t offset, uint64_t length) {
+    return decompressRange(in, body_offset, readIndex(in, body_offset, body_end), offset, length);
+}
+
+std::vector<uint8_t> decompressRange(std::istream& in, uint64_t body_offset, const std::vector<FrameInfo>& frames,
+                                     uint64_t offset, uint64_t length) {
+    const uint64_t total = frames.empty() ? 0 : frames.back().raw_offset + frames.back().raw_size;
+    if (offset >= total || length == 0) return {};
+    const uint64_t end = offset + std::min(length, total - offset);
+    size_t first, last;
+    coveringFrames(frames, offset, end, first, last);
+
+    std::vector<uint8_t> result;
+    result.reserve(end - offset);
+    uint64_t pos = frames[first].raw_offset;
+    decompressFrames(in, body_offset, frames, first, last, [&](const uint8_t* data, size_t size) {
+        const uint64_t from = std::max(pos, offset);
+        const uint64_t to = std::min(pos + size, end);
+        if (from < to) result.insert(result.end(), data + (from - pos), data + (to - pos));
+        pos += size;
+    });
+    return result;
+}
+
+} // namespace deflate_stream
@@ -0,0 +1,240 @@
+#ifndef DEFLATE_STREAM_H
+#define DEFLATE_STREAM_H
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <vector>
+#include "lz77.h"
+#include "lz77_tokens.h"
+
+// Compresión LZ77 + Huffman por streaming con memoria acotada.
+//
+// La entrada se parte en chunks (frames) de tamaño fijo. Cada frame se comprime con
+// LZ77 usando como diccionario los últimos WINDOW_SIZE bytes del frame anterior y
+// luego con Huffman, y se emite en cuanto está listo. Así la memoria depende del
+// tamaño del chunk y no del tamaño total del archivo.
+//
+// Formato:
+//   frame*: [u8 tipo][u32 raw_size][u32 comp_size][payload comp_size bytes]
+//   fin:    [u8 FRAME_END]
+// Con tipo FRAME_LZ77_HUFFMAN el payload es un stream Huffman (simple o por bloques,
+// ver huffman.h) del LZ77 del chunk.
+// Con FRAME_LZ77_WIDE_HUFFMAN (ventana larga) el payload es [u8 window_log] seguido
+// del stream Huffman del LZ77 formato Wide; la historia es de 1 << window_log bytes.
+// Con FRAME_TOKENS_HUFFMAN el payload es [u8 window_log] seguido de lz77_tokens::encode
+// (literales/longitudes y distancias en alfabetos separados, ver lz77_tokens.h); las
+// secciones pueden ser Huffman o FSE según el backend elegido al comprimir.
+// Con FRAME_STORED el payload son los raw_size bytes del chunk sin comprimir: se usa
+// cuando entropy_probe lo ve incompresible o cuando comprimirlo no lo achica.
+// Con FRAME_CM_BYTES el payload es un stream de cm.h sobre los bytes crudos del chunk
+// (sin LZ77); solo lo genera el modo max cuando queda más chico que los tokens.
+// Si el tipo trae el bit FRAME_CHECKSUM el payload empieza con [u32 CRC32C] de los
+// raw_size bytes originales (incluido en comp_size) y el decoder lo verifica en cada
+// frame. Todos los frames nuevos lo llevan; los viejos sin el bit se siguen leyendo.
+// Si el tipo trae el bit FRAME_WINDOW (solo FRAME_STORED y FRAME_CM_BYTES, que no usan
+// LZ77) después del CRC va [u8 window_log] de la ventana larga del stream, para que el
+// decoder guarde esa historia aunque el frame no tenga referencias.
+//
+// Frames independientes (.chupy v3): mismo formato de frame pero cada uno se comprime
+// sin historia, así que se pueden comprimir y descomprimir en paralelo o por separado.
+// Después del FRAME_END va un índice para ubicarlos sin recorrer el stream:
+//   [frame*][u8 FRAME_END][por frame: u32 raw_size, u32 comp_size][u32 num_frames]
+//   [u32 INDEX_MAGIC]
+// comp_size incluye la cabecera del frame. Como no hay referencias hacia atrás, un
+// StreamDecompressor también lo decodifica en serie (ignora lo que sigue a FRAME_END).
+
+namespace deflate_stream {
+
+constexpr uint8_t FRAME_END          = 0;
+constexpr uint8_t FRAME_LZ77_HUFFMAN = 1;
+constexpr uint8_t FRAME_LZ77_WIDE_HUFFMAN = 2;
+constexpr uint8_t FRAME_TOKENS_HUFFMAN    = 3;
+constexpr uint8_t FRAME_STORED            = 4;
+constexpr uint8_t FRAME_CM_BYTES          = 5;
+
+constexpr uint8_t FRAME_CHECKSUM          = 0x80;  // bit del tipo: payload con CRC32C
+constexpr uint8_t FRAME_WINDOW            = 0x40;  // bit del tipo: stored/CM con window_log
+
+constexpr size_t FRAME_HEADER_SIZE  = 9;        // tipo + raw_size + comp_size
+constexpr size_t CHECKSUM_SIZE      = 4;        // CRC32C al inicio del payload
+constexpr size_t DEFAULT_CHUNK_SIZE = 4 << 20;  // 4 MiB de entrada por frame
+constexpr size_t MAX_FRAME_SIZE     = 1 << 30;  // límite de cordura al leer
+
+constexpr size_t   INDEPENDENT_FRAME_SIZE = 2 << 20;     // 2 MiB de entrada por frame independiente
+constexpr uint32_t INDEX_MAGIC            = 0x58444943;  // "CIDX"
+constexpr size_t   INDEX_ENTRY_SIZE       = 8;           // raw_size + comp_size
+constexpr size_t   INDEX_TRAILER_SIZE     = 8;           // num_frames + INDEX_MAGIC
+// Memoria aproximada de cada frame en vuelo (entrada, cadenas hash de LZ77, tokens y
+// salida), en múltiplos del tamaño del frame; sirve para acotar batch_frames
+constexpr size_t   FRAME_MEMORY_FACTOR    = 6;
+
+// Cómo se modela la salida de LZ77 antes de Huffman
+enum class Coding : uint8_t {
+    Bytes,   // el stream de bytes de LZ77 con un único alfabeto de 256 símbolos
+    Tokens,  // tokens separados estilo DEFLATE (mejor ratio)
+};
+
+// Recibe la salida a medida que se produce
+using Sink = std::function<void(const uint8_t* data, size_t size)>;
+
+class StreamCompressor {
+public:
+    explicit StreamCompressor(const LZ77::Options& options = LZ77::Options(),
+                              size_t chunk_size = DEFAULT_CHUNK_SIZE,
+                              Coding coding = Coding::Tokens,
+                              lz77_tokens::Entropy entropy = lz77_tokens::Entropy::Huffman);
+
+    // Inicia un stream nuevo; toda la salida va a sink
+    void begin(Sink sink);
+    // Agrega datos; emite un frame cada vez que se completa un chunk
+    void feed(const uint8_t* data, size_t size);
+    // Emite el último frame parcial y el marcador de fin
+    void finish();
+
+    uint64_t bytesIn() const { return bytes_in_; }
+    uint64_t lz77Bytes() const { return lz77_bytes_; }
+    uint64_t bytesOut() const { return bytes_out_; }
+
+private:
+    void emitFrame();
+    void emit(const uint8_t* data, size_t size);
+
+    LZ77::Options options_;
+    size_t chunk_size_;
+    Coding coding_;
+    lz77_tokens::Entropy entropy_;
+    Sink sink_;
+
+    // [historia (hasta windowSize(options_) bytes) | chunk pendiente]
+    std::vector<uint8_t> window_;
+    size_t history_ = 0;
+    size_t history_max_;
+
+    uint64_t bytes_in_ = 0;
+    uint64_t lz77_bytes_ = 0;
+    uint64_t bytes_out_ = 0;
+};
+
+class StreamDecompressor {
+public:
+    StreamDecompressor() = default;
+
+    // Inicia un stream nuevo; los bytes descomprimidos van a sink
+    void begin(Sink sink);
+    // Agrega bytes comprimidos (en trozos de cualquier tamaño)
+    void feed(const uint8_t* data, size_t size);
+    // Verifica que el stream terminó con FRAME_END; lanza si quedó truncado
+    void finish();
+
+    bool done() const { return done_; }
+    uint64_t bytesOut() const { return bytes_out_; }
+
+private:
+    bool decodeNextFrame();
+
+    Sink sink_;
+    std::vector<uint8_t> pending_;   // bytes comprimidos aún no consumidos
+    size_t pending_pos_ = 0;
+
+    // [historia (hasta history_max_ bytes) | salida del frame actual]
+    std::vector<uint8_t> window_;
+    size_t history_ = 0;
+    size_t history_max_ = LZ77::WINDOW_SIZE;  // crece con la ventana de los frames
+
+    bool done_ = false;
+    uint64_t bytes_out_ = 0;
+};
+
+// ---------- frames independientes ----------
+
+// Entrada del índice; los offsets se calculan al leerlo
+struct FrameInfo {
+    uint32_t raw_size;
+    uint32_t comp_size;      // incluye la cabecera de FRAME_HEADER_SIZE bytes
+    uint64_t raw_offset;     // posición de su primer byte en el archivo original
+    uint64_t comp_offset;    // posición del frame desde el inicio del body
+};
+
+// Comprime data en un único frame sin historia (cabecera incluida)
+std::vector<uint8_t> compressFrame(const uint8_t* data, size_t size,
+                                   const LZ77::Options& options = LZ77::Options(),
+                                   Coding coding = Coding::Tokens,
+                                   lz77_tokens::Entropy entropy = lz77_tokens::Entropy::Huffman,
+                                   uint64_t* lz77_bytes = nullptr);
+
+// Decodifica un frame completo de size bytes (sin historia) en out; devuelve raw_size
+size_t decompressFrame(const uint8_t* frame, size_t size, uint8_t* out, size_t capacity);
+
+// Igual que StreamCompressor pero con frames independientes: comprime lotes de
+// batch_frames frames en paralelo (0 = uno por hilo), los emite en orden y al final
+// escribe FRAME_END y el índice
+class FramedCompressor {
+public:
+    explicit FramedCompressor(const LZ77::Options& options = LZ77::Options(),
+                              size_t frame_size = INDEPENDENT_FRAME_SIZE,
+                              Coding coding = Coding::Tokens,
+                              lz77_tokens::Entropy entropy = lz77_tokens::Entropy::Huffman,
+                              size_t batch_frames = 0);
+
+    void begin(Sink sink);
+    void feed(const uint8_t* data, size_t size);
+    // Cierra el frame en curso aunque no llegue a frame_size (para alinear los frames
+    // con límites de archivos); no hace nada si está vacío
+    void endFrame();
+    void finish();
+
+    uint64_t bytesIn() const { return bytes_in_; }
+    uint64_t lz77Bytes() const { return lz77_bytes_; }
+    uint64_t bytesOut() const { return bytes_out_; }
+    const std::vector<FrameInfo>& frames() const { return frames_; }
+
+private:
+    size_t frameStart() const { return cuts_.empty() ? 0 : cuts_.back(); }
+    void flushBatch();
+    void emit(const uint8_t* data, size_t size);
+
+    LZ77::Options options_;
+    size_t frame_size_;
+    Coding coding_;
+    lz77_tokens::Entropy entropy_;
+    Sink sink_;
+
+    std::vector<uint8_t> pending_;   // entrada de hasta batch_frames_ frames
+    std::vector<size_t> cuts_;       // fin de cada frame cerrado dentro de pending_
+    size_t batch_frames_;
+    std::vector<FrameInfo> frames_;
+
+    uint64_t bytes_in_ = 0;
+    uint64_t lz77_bytes_ = 0;
+    uint64_t bytes_out_ = 0;
+};
+
+// Lee y valida el índice de un body de frames independientes que ocupa
+// [body_offset, body_end) en in
+std::vector<FrameInfo> readIndex(std::istream& in, uint64_t body_offset, uint64_t body_end);
+
+// Frames [first, last) que cubren los bytes [offset, end) del original
+void coveringFrames(const std::vector<FrameInfo>& frames, uint64_t offset, uint64_t end,
+                    size_t& first, size_t& last);
+
+// Decodifica frames[first, last) del índice en paralelo por lotes y pasa la salida a
+// sink en orden; devuelve los bytes producidos
+uint64_t decompressFrames(std::istream& in, uint64_t body_offset, const std::vector<FrameInfo>& frames,
+                          size_t first, size_t last, const Sink& sink);
+
+// Decodifica todo el body
+uint64_t decompressFramed(std::istream& in, uint64_t body_offset, uint64_t body_end, const Sink& sink);
+
+// Decodifica solo los frames que cubren [offset, offset + length) del original y
+// devuelve esos bytes; si el rango pasa del final se recorta
+std::vector<uint8_t> decompressRange(std::istream& in, uint64_t body_offset, uint64_t body_end,
+                                     uint64_t offset, uint64_t length);
+// Igual pero con el índice ya leído (para varios rangos del mismo archivo)
+std::vector<uint8_t> decompressRange(std::istream& in, uint64_t body_offset, const std::vector<FrameInfo>& frames,
+                                     uint64_t offset, uint64_t length);
+
+} // namespace deflate_stream
+
+#endif
@@ -0,0 +1,65 @@
+#include "entropy_probe.h"
+#include "histogram.h"
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace entropy_probe {
+
+static constexpr int REPEAT_HASH_BITS = 12;
+
+static inline uint32_t load32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+Estimate estimate(const uint8_t* data, size_t size) {
+    Estimate result;
+    if (size == 0) return result;
+
+    // Trozos repartidos uniformemente (o toda la entrada si es chica)
+    const size_t slice = std::min(size, SLICE_SIZE);
+    const size_t slices = std::min(SAMPLE_SLICES, size / slice);
+    const size_t stride = (slices > 1) ? (size - slice) / (slices - 1) : 0;
+
+    uint32_t hist[256] = {0};
+    size_t sampled = 0;
+    size_t positions = 0;
+    size_t repeats = 0;
+    std::vector<uint16_t> last(size_t(1) << REPEAT_HASH_BITS);
+
+    for (size_t s = 0; s < slices; ++s) {
+        const uint8_t* p = data + s * stride;
+        histogram::countBytes(p, slice, hist);
+        sampled += slice;
+
+        // 4-gramas repetidos dentro del trozo (last guarda posición + 1; 0 = vacío)
+        std::fill(last.begin(), last.end(), 0);
+        for (size_t i = 0; i + 4 <= slice; ++i) {
+            uint32_t v = load32(p + i);
+            uint32_t h = (v * 2654435761u) >> (32 - REPEAT_HASH_BITS);
+            if (last[h] != 0 && load32(p + last[h] - 1) == v) repeats++;
+            last[h] = (uint16_t)(i + 1);
+            positions++;
+        }
+    }
+
+    double entropy = 0.0;
+    for (uint32_t count : hist) {
+        if (count == 0) continue;
+        double prob = (double)count / (double)sampled;
+        entropy -= prob * std::log2(prob);
+    }
+    result.entropy = entropy;
+    result.repeat_rate = positions ? (double)repeats / (double)positions : 0.0;
+    return result;
+}
+
+bool looksIncompressible(const uint8_t* data, size_t size) {
+    if (size < MIN_PROBE_SIZE) return false;
+    Estimate e = estimate(data, size);
+    return e.entropy >= MIN_ENTROPY && e.repeat_rate <= MAX_REPEAT_RATE;
+}
+
+} // namespace entropy_probe
@@ -0,0 +1,37 @@
+#ifndef ENTROPY_PROBE_H
+#define ENTROPY_PROBE_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Detección barata de datos incompresibles (JPEG, PNG, zip, datos cifrados...).
+//
+// Se muestrean hasta SAMPLE_SLICES trozos de SLICE_SIZE bytes repartidos por la entrada
+// y en cada uno se mide:
+//   - la entropía de orden 0 (bits por byte según el histograma)
+//   - la fracción de posiciones cuyos 4 bytes ya aparecieron antes en el trozo
+// Si la entropía es casi 8 bits y casi no hay repeticiones, ni LZ77 ni Huffman van a
+// ganar nada y conviene guardar los datos tal cual.
+
+namespace entropy_probe {
+
+constexpr size_t MIN_PROBE_SIZE  = 4096;   // con menos no se puede decidir
+constexpr size_t SAMPLE_SLICES   = 16;
+constexpr size_t SLICE_SIZE      = 4096;   // 64 KiB muestreados como máximo
+constexpr double MIN_ENTROPY     = 7.8;    // bits por byte
+constexpr double MAX_REPEAT_RATE = 0.05;   // fracción de 4-gramas repetidos
+
+struct Estimate {
+    double entropy = 0.0;      // bits por byte del histograma de la muestra
+    double repeat_rate = 0.0;  // fracción de posiciones con un 4-grama ya visto
+};
+
+// Mide la muestra (data debe tener al menos 4 bytes para que repeat_rate tenga sentido)
+Estimate estimate(const uint8_t* data, size_t size);
+
+// true si data parece incompresible (nunca para entradas menores a MIN_PROBE_SIZE)
+bool looksIncompressible(const uint8_t* data, size_t size);
+
+} // namespace entropy_probe
+
+#endif
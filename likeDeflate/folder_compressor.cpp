@@ -1,12 +1,23 @@
 #include "folder_compressor.h"
 #include "lz77.h"
 #include "huffman.h"
+#include "lz77_tokens.h"
+#include "entropy_probe.h"
 #include <fstream>
 #include <filesystem>
 #include <stdexcept>
 #include <cstring>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <exception>
+#include <algorithm>
+#include <cctype>
 #include <omp.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
 
 namespace fs = std::filesystem;
 
@@ -38,6 +49,20 @@ static void writeFileBinary(const std::string& path, const std::vector<uint8_t>&
     }
 }
 
+static void writeU64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        p[i] = static_cast<uint8_t>((v >> (i * 8)) & 0xFF);
+    }
+}
+
+static uint64_t readU64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        v |= static_cast<uint64_t>(p[i]) << (i * 8);
+    }
+    return v;
+}
+
 // Serialización de metadata
 std::vector<uint8_t> serializeMetadata(const std::vector<FileEntry>& entries) {
     std::vector<uint8_t> buffer;
@@ -67,6 +92,17 @@ std::vector<uint8_t> serializeMetadata(const std::vector<FileEntry>& entries) {
     return buffer;
 }
 
+// Las rutas vienen del archivo: solo se aceptan relativas que queden dentro de la carpeta
+// de salida (sin raíz ni "..")
+static bool isSafeRelativePath(const std::string& path) {
+    const fs::path normal = fs::path(path).lexically_normal();
+    if (normal.empty() || normal.has_root_path() || normal == ".") return false;
+    for (const auto& part : normal) {
+        if (part == "..") return false;
+    }
+    return true;
+}
+
 std::vector<FileEntry> deserializeMetadata(const uint8_t* data, size_t size) {
     std::vector<FileEntry> entries;
     size_t pos = 0;
@@ -81,6 +117,9 @@ std::vector<FileEntry> deserializeMetadata(const uint8_t* data, size_t size) {
         if (pos + path_len > size) break;
         std::string path(reinterpret_cast<const char*>(data + pos), path_len);
         pos += path_len;
+        if (!isSafeRelativePath(path)) {
+            throw std::runtime_error("Ruta inválida en la metadata: " + path);
+        }
         
         // Leer offset
         if (pos + 8 > size) break;
@@ -106,7 +145,239 @@ std::vector<FileEntry> deserializeMetadata(const uint8_t* data, size_t size) {
 
 // Compresión de carpeta
 
-void compressFolder(const std::string& folder_path, const std::string& output_file) {
+// Contenido leído de cada archivo de la carpeta
+struct FileData {
+    std::string relative_path;
+    std::vector<uint8_t> content;
+    bool success;
+    
+    FileData() : success(false) {}
+};
+
+// ---------- pipeline de compresión por segmentos (v5) ----------
+
+// Cola entre dos etapas del pipeline con capacidad en bytes: push espera si está llena
+// y pop si está vacía. close() avisa que no vienen más datos; abort() corta ambos
+// lados cuando una etapa falla.
+class ByteQueue {
+public:
+    explicit ByteQueue(size_t capacity) : capacity_(capacity) {}
+    
+    // Devuelve false si la cola se abortó
+    bool push(std::vector<uint8_t> item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        // Un item más grande que la capacidad entra solo con la cola vacía
+        not_full_.wait(lock, [&] { return aborted_ || used_ == 0 || used_ + item.size() <= capacity_; });
+        if (aborted_) return false;
+        used_ += item.size();
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+        return true;
+    }
+    
+    // Devuelve false cuando no hay más datos (cerrada y vacía, o abortada)
+    bool pop(std::vector<uint8_t>& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [&] { return aborted_ || closed_ || !items_.empty(); });
+        if (aborted_ || items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        used_ -= item.size();
+        not_full_.notify_one();
+        return true;
+    }
+    
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+    
+    void abort() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        aborted_ = true;
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+    
+private:
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<std::vector<uint8_t>> items_;
+    size_t capacity_;
+    size_t used_ = 0;
+    bool closed_ = false;
+    bool aborted_ = false;
+};
+
+// Extensión en minúsculas, para ordenar los archivos por tipo
+static std::string extensionKey(const std::string& path) {
+    std::string ext = fs::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    return ext;
+}
+
+// Tamaño de cada lectura de la etapa lectora
+constexpr size_t READ_CHUNK = 1 << 20;
+// Tamaño objetivo de cada grupo en SolidMode::Grouped: un frame independiente
+constexpr uint64_t GROUP_TARGET = deflate_stream::INDEPENDENT_FRAME_SIZE;
+// Capacidad de cada cola cuando no hay --max-memory
+constexpr size_t DEFAULT_QUEUE_BYTES = 64 << 20;
+
+struct PipelinePlan {
+    size_t batch_frames;   // frames que se comprimen a la vez
+    size_t queue_bytes;    // capacidad de cada cola
+};
+
+// Reparte --max-memory: la mitad para los frames en vuelo del compresor y un cuarto
+// para cada cola. Sin límite, un frame por hilo y colas de DEFAULT_QUEUE_BYTES.
+static PipelinePlan planMemory(int max_memory_mib) {
+    const size_t threads = static_cast<size_t>(std::max(1, omp_get_max_threads()));
+    if (max_memory_mib <= 0) {
+        return {threads, DEFAULT_QUEUE_BYTES};
+    }
+    const size_t budget = static_cast<size_t>(max_memory_mib) << 20;
+    const size_t frame_memory = deflate_stream::INDEPENDENT_FRAME_SIZE * deflate_stream::FRAME_MEMORY_FACTOR;
+    const size_t batch = std::min(threads, std::max<size_t>(1, budget / 2 / frame_memory));
+    return {batch, std::max(budget / 4, READ_CHUNK)};
+}
+
+// Formato v5 como pipeline de tres etapas con memoria acotada: un hilo lee los
+// archivos en orden, este hilo los comprime en frames independientes (cada lote en
+// paralelo) y otro hilo escribe los frames en orden mientras se comprime el siguiente
+// lote. La metadata va al final y el header se completa al terminar.
+// Los frames se cortan en límites de archivo: al cerrar cada grupo (Grouped) o cada
+// archivo (None) el lector manda un trozo vacío como marca de fin de frame.
+static void compressSegmented(const std::vector<std::string>& file_paths, const fs::path& base_path,
+                              const std::string& output_file, const LZ77::Options& lz_options,
+                              const OpcionesCompresion& opciones) {
+    std::ofstream out(output_file, std::ios::binary);
+    if (!out) throw std::runtime_error("No se pudo escribir: " + output_file);
+    
+    ChupyDirHeader header;
+    header.version = CHUPYDIR_VERSION_SEGMENTS;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    
+    const PipelinePlan plan = planMemory(opciones.memoriaMaxMiB);
+#if defined(M_ARENA_MAX)
+    // glibc deja una arena de malloc por hilo que retiene lo liberado; con un presupuesto
+    // chico eso solo ya lo supera
+    if (opciones.memoriaMaxMiB > 0) mallopt(M_ARENA_MAX, 2);
+#endif
+    ByteQueue read_queue(plan.queue_bytes);
+    ByteQueue write_queue(plan.queue_bytes);
+    std::vector<FileEntry> file_entries;
+    std::exception_ptr reader_error;
+    std::exception_ptr writer_error;
+    
+    // Etapa 1: lectura por trozos; los archivos que no se pueden abrir se omiten
+    const bool grouped = opciones.modoSolido == SolidMode::Grouped;
+    std::thread reader([&] {
+        try {
+            std::vector<uint8_t> buffer(READ_CHUNK);
+            uint64_t offset = 0;
+            uint64_t group = 0;   // bytes del grupo en curso
+            for (const auto& path : file_paths) {
+                std::ifstream f(path, std::ios::binary);
+                if (!f) continue;
+                // Un archivo que no entra en el grupo en curso empieza uno nuevo
+                std::error_code ec;
+                const uint64_t expected = fs::file_size(path, ec);
+                if (grouped && group > 0 && !ec && group + expected > GROUP_TARGET) {
+                    if (!read_queue.push(std::vector<uint8_t>())) return;
+                    group = 0;
+                }
+                uint64_t size = 0;
+                while (f) {
+                    f.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+                    const std::streamsize got = f.gcount();
+                    if (got <= 0) break;
+                    // Copia del tamaño justo: la cola cuenta bytes, no capacidad
+                    size += static_cast<uint64_t>(got);
+                    if (!read_queue.push(std::vector<uint8_t>(buffer.data(), buffer.data() + got))) return;
+                }
+                file_entries.emplace_back(fs::relative(path, base_path).string(), offset, size);
+                offset += size;
+                group += size;
+                if (!grouped || group >= GROUP_TARGET) {
+                    if (!read_queue.push(std::vector<uint8_t>())) return;
+                    group = 0;
+                }
+            }
+        } catch (...) {
+            reader_error = std::current_exception();
+        }
+        read_queue.close();
+    });
+    
+    // Etapa 3: escritura en orden
+    std::thread writer([&] {
+        std::vector<uint8_t> item;
+        while (write_queue.pop(item)) {
+            out.write(reinterpret_cast<const char*>(item.data()), item.size());
+            if (!out) {
+                writer_error = std::make_exception_ptr(std::runtime_error("No se pudo escribir: " + output_file));
+                write_queue.abort();
+                read_queue.abort();
+                return;
+            }
+        }
+    });
+    
+    // Etapa 2: compresión
+    deflate_stream::FramedCompressor compressor(lz_options, deflate_stream::INDEPENDENT_FRAME_SIZE,
+                                                opciones.codificacion, opciones.entropia, plan.batch_frames);
+    try {
+        compressor.begin([&](const uint8_t* data, size_t size) {
+            if (!write_queue.push(std::vector<uint8_t>(data, data + size))) {
+                throw std::runtime_error("No se pudo escribir: " + output_file);
+            }
+        });
+        std::vector<uint8_t> chunk;
+        while (read_queue.pop(chunk)) {
+            if (chunk.empty()) {
+                compressor.endFrame();
+            } else {
+                compressor.feed(chunk.data(), chunk.size());
+            }
+        }
+        reader.join();
+        if (reader_error) std::rethrow_exception(reader_error);
+        if (file_entries.empty()) {
+            throw std::runtime_error("No se pudo leer ningún archivo");
+        }
+        compressor.finish();
+        write_queue.close();
+        writer.join();
+        if (writer_error) std::rethrow_exception(writer_error);
+    } catch (...) {
+        read_queue.abort();
+        write_queue.abort();
+        if (reader.joinable()) reader.join();
+        if (writer.joinable()) writer.join();
+        out.close();
+        std::error_code ec;
+        if (fs::is_regular_file(output_file, ec)) fs::remove(output_file, ec);
+        if (writer_error) std::rethrow_exception(writer_error);
+        throw;
+    }
+    
+    auto metadata_bytes = serializeMetadata(file_entries);
+    out.write(reinterpret_cast<const char*>(metadata_bytes.data()), metadata_bytes.size());
+    
+    header.num_files = static_cast<uint32_t>(file_entries.size());
+    header.total_uncompressed = compressor.bytesIn();
+    header.metadata_size = static_cast<uint64_t>(metadata_bytes.size());
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    
+    out.close();
+    if (!out) throw std::runtime_error("No se pudo escribir: " + output_file);
+}
+
+void compressFolder(const std::string& folder_path, const std::string& output_file,
+                    const OpcionesCompresion& opciones) {
     if (!fs::exists(folder_path) || !fs::is_directory(folder_path)) {
         throw std::runtime_error("La ruta no es una carpeta válida: " + folder_path);
     }
@@ -125,14 +396,24 @@ void compressFolder(const std::string& folder_path, const std::string& output_fi
         throw std::runtime_error("No se encontraron archivos en la carpeta");
     }
     
-    // Estructura para guardar datos de archivos
-    struct FileData {
-        std::string relative_path;
-        std::vector<uint8_t> content;
-        bool success;
-        
-        FileData() : success(false) {}
-    };
+    const LZ77::Options lz_options = opcionesLZ77(opciones);
+    
+    // Salvo en modo sólido completo se usan frames independientes (v5) en un pipeline
+    // con memoria acotada; además se pueden extraer archivos sueltos. Con ventana larga
+    // el stream siempre es sólido y en memoria para no perder las repeticiones entre
+    // archivos lejanos.
+    if (opciones.modoSolido != SolidMode::None) {
+        // Archivos del mismo tipo juntos: comparten vocabulario y quedan en los mismos
+        // grupos, o cerca dentro del stream sólido
+        std::sort(file_paths.begin(), file_paths.end(), [](const std::string& a, const std::string& b) {
+            const std::string ea = extensionKey(a), eb = extensionKey(b);
+            return ea != eb ? ea < eb : a < b;
+        });
+    }
+    if (opciones.modoSolido != SolidMode::Full && LZ77::formatFor(lz_options) == LZ77::Format::Classic) {
+        compressSegmented(file_paths, base_path, output_file, lz_options, opciones);
+        return;
+    }
     
     std::vector<FileData> file_data_vec(file_paths.size());
     
@@ -151,46 +432,75 @@ void compressFolder(const std::string& folder_path, const std::string& output_fi
         }
     }
     
+    const bool tokens = opciones.codificacion == deflate_stream::Coding::Tokens;
+    // Los archivos incompresibles (JPEG, PNG, zip...) se guardan aparte, sin comprimir.
+    // Con ventana larga no se separan: pueden repetirse entre archivos lejanos.
+    const bool probe = tokens && LZ77::formatFor(lz_options) == LZ77::Format::Classic;
+    
     // Concatenar archivos leídos exitosamente
     std::vector<FileEntry> file_entries;
     std::vector<uint8_t> concatenated_buffer;
+    std::vector<uint8_t> stored_buffer;
+    std::vector<size_t> stored_entries;
     
     concatenated_buffer.reserve(file_paths.size() * 10240);
     
     for (const auto& fd : file_data_vec) {
         if (fd.success) {
+            auto& target = (probe && entropy_probe::looksIncompressible(fd.content.data(), fd.content.size()))
+                               ? stored_buffer : concatenated_buffer;
+            if (&target == &stored_buffer) {
+                stored_entries.push_back(file_entries.size());
+            }
             file_entries.emplace_back(
                 fd.relative_path,
-                concatenated_buffer.size(),
+                target.size(),
                 fd.content.size()
             );
             
-            concatenated_buffer.insert(
-                concatenated_buffer.end(),
+            target.insert(
+                target.end(),
                 fd.content.begin(),
                 fd.content.end()
             );
         }
     }
     
+    // Los guardados quedan después de todo lo comprimido
+    for (size_t i : stored_entries) {
+        file_entries[i].offset += concatenated_buffer.size();
+    }
+    
     if (file_entries.empty()) {
         throw std::runtime_error("No se pudo leer ningún archivo");
     }
     
     // Comprimir con LZ77
-    auto lz77_data = LZ77::compress(concatenated_buffer);
-    
-    // Aplicar Huffman sobre LZ77
-    std::vector<uint32_t> symbols(lz77_data.begin(), lz77_data.end());
-    auto huffman_data = huff::encodeHuffmanStream(symbols, 256, 15);
+    auto lz77_data = LZ77::compress(concatenated_buffer, lz_options);
+    
+    // Aplicar Huffman sobre LZ77 (tokens separados o el stream de bytes)
+    std::vector<uint8_t> huffman_data;
+    if (tokens) {
+        huffman_data = lz77_tokens::encode(lz77_data.data(), lz77_data.size(), LZ77::formatFor(lz_options),
+                                           opciones.entropia);
+    } else {
+        huffman_data = huff::encodeHuffmanStreamBlocked(lz77_data.data(), lz77_data.size(), 256, 15);
+    }
     
     // Serializar metadata
     auto metadata_bytes = serializeMetadata(file_entries);
     
     //Crear header
     ChupyDirHeader header;
+    if (!stored_buffer.empty()) {
+        header.version = CHUPYDIR_VERSION_STORED;
+    } else if (tokens) {
+        header.version = CHUPYDIR_VERSION_TOKENS;
+    } else if (LZ77::formatFor(lz_options) == LZ77::Format::Wide) {
+        header.version = CHUPYDIR_VERSION_WIDE;
+    }
     header.num_files = static_cast<uint32_t>(file_entries.size());
-    header.total_uncompressed = static_cast<uint64_t>(concatenated_buffer.size());
+    header.total_uncompressed = static_cast<uint64_t>(concatenated_buffer.size() + stored_buffer.size());
     header.metadata_size = static_cast<uint64_t>(metadata_bytes.size());
     
     // Ensamblar archivo final
@@ -205,31 +515,59 @@ void compressFolder(const std::string& folder_path, const std::string& output_fi
                        metadata_bytes.begin(),
                        metadata_bytes.end());
     
+    if (header.version == CHUPYDIR_VERSION_STORED) {
+        uint8_t size_bytes[8];
+        writeU64(size_bytes, huffman_data.size());
+        final_output.insert(final_output.end(), size_bytes, size_bytes + 8);
+    }
+    
     final_output.insert(final_output.end(),
                        huffman_data.begin(),
                        huffman_data.end());
     
+    final_output.insert(final_output.end(),
+                       stored_buffer.begin(),
+                       stored_buffer.end());
+    
     //Guardar archivo
     writeFileBinary(output_file, final_output);
 }
 
 // Descompresión de carpeta
 
-void decompressFolder(const std::string& input_file, const std::string& output_folder) {
-    // Leer archivo completo
-    auto file_data = readFileBinary(input_file);
-    
-    if (file_data.size() < sizeof(ChupyDirHeader)) {
+static ChupyDirHeader readDirHeader(std::istream& in) {
+    ChupyDirHeader header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if ((size_t)in.gcount() != sizeof(header)) {
         throw std::runtime_error("Archivo demasiado pequeño o corrupto");
     }
-    
-    // Leer header
-    ChupyDirHeader header;
-    std::memcpy(&header, file_data.data(), sizeof(header));
-    
     if (!header.isValid()) {
         throw std::runtime_error("No es un archivo .chupydir válido");
     }
+    if (header.version != CHUPYDIR_VERSION_CLASSIC && header.version != CHUPYDIR_VERSION_WIDE &&
+        header.version != CHUPYDIR_VERSION_TOKENS && header.version != CHUPYDIR_VERSION_STORED &&
+        header.version != CHUPYDIR_VERSION_SEGMENTS) {
+        throw std::runtime_error("Versión de .chupydir no soportada");
+    }
+    return header;
+}
+
+// Escribe un archivo extraído creando sus subcarpetas
+static void writeEntry(const std::string& output_folder, const FileEntry& entry, const uint8_t* data) {
+    fs::path output_path = fs::path(output_folder) / entry.relative_path;
+    fs::create_directories(output_path.parent_path());
+    std::ofstream f(output_path, std::ios::binary);
+    if (!f) throw std::runtime_error("No se pudo escribir: " + output_path.string());
+    if (entry.size > 0) {
+        f.write(reinterpret_cast<const char*>(data), entry.size);
+    }
+}
+
+// Formatos sólidos (v1-v4): decodifica el concatenado completo en memoria
+static std::vector<uint8_t> decodeSolid(const std::vector<uint8_t>& file_data, const ChupyDirHeader& header,
+                                        std::vector<FileEntry>& file_entries) {
+    const LZ77::Format format = (header.version == CHUPYDIR_VERSION_WIDE)
+                                    ? LZ77::Format::Wide : LZ77::Format::Classic;
     
     // Leer metadata
     size_t metadata_start = sizeof(ChupyDirHeader);
@@ -239,7 +577,7 @@ void decompressFolder(const std::string& input_file, const std::string& output_f
         throw std::runtime_error("Metadata corrupta o truncada");
     }
     
-    auto file_entries = deserializeMetadata(
+    file_entries = deserializeMetadata(
         file_data.data() + metadata_start,
         header.metadata_size
     );
@@ -252,15 +590,175 @@ void decompressFolder(const std::string& input_file, const std::string& output_f
     const uint8_t* compressed_start = file_data.data() + metadata_end;
     size_t compressed_size = file_data.size() - metadata_end;
     
-    auto symbols = huff::decodeHuffmanStream(compressed_start, compressed_size);
-    std::vector<uint8_t> lz77_data(symbols.begin(), symbols.end());
+    // Descomprimir LZ77 directo al buffer final (el header ya trae el tamaño exacto)
+    std::vector<uint8_t> decompressed(header.total_uncompressed);
+    size_t produced;
+    if (header.version == CHUPYDIR_VERSION_STORED) {
+        if (compressed_size < 8) {
+            throw std::runtime_error("Datos comprimidos truncados");
+        }
+        uint64_t tokens_size = readU64(compressed_start);
+        if (tokens_size > compressed_size - 8) {
+            throw std::runtime_error("Datos comprimidos truncados");
+        }
+        const uint8_t* stored_start = compressed_start + 8 + tokens_size;
+        size_t stored_size = compressed_size - 8 - tokens_size;
+        if (stored_size > decompressed.size()) {
+            throw std::runtime_error("Tamaño descomprimido no coincide");
+        }
+        size_t lz_size = decompressed.size() - stored_size;
+        produced = lz77_tokens::decodeInto(compressed_start + 8, tokens_size, decompressed.data(), lz_size);
+        if (produced == lz_size && stored_size > 0) {
+            std::memcpy(decompressed.data() + lz_size, stored_start, stored_size);
+            produced += stored_size;
+        }
+    } else if (header.version == CHUPYDIR_VERSION_TOKENS) {
+        produced = lz77_tokens::decodeInto(compressed_start, compressed_size,
+                                           decompressed.data(), decompressed.size());
+    } else {
+        std::vector<uint8_t> lz77_data(huff::decodedSymbolCount(compressed_start, compressed_size));
+        huff::decodeHuffmanStreamInto(compressed_start, compressed_size, lz77_data.data(), lz77_data.size());
+        produced = LZ77::decompressInto(lz77_data.data(), lz77_data.size(),
+                                        decompressed.data(), decompressed.size(), 0, format);
+    }
     
-    // Descomprimir LZ77
-    auto decompressed = LZ77::decompress(lz77_data);
+    if (produced != header.total_uncompressed) {
+        throw std::runtime_error("Tamaño descomprimido no coincide");
+    }
+    return decompressed;
+}
+
+// Formato v5: metadata del final e índice de frames, sin leer el resto del archivo
+struct SegmentedArchive {
+    std::vector<FileEntry> entries;
+    std::vector<deflate_stream::FrameInfo> frames;
+};
+
+static SegmentedArchive openSegmented(std::istream& in, const ChupyDirHeader& header) {
+    in.seekg(0, std::ios::end);
+    const uint64_t file_size = static_cast<uint64_t>(in.tellg());
+    const uint64_t body_offset = sizeof(ChupyDirHeader);
+    if (header.metadata_size > file_size - body_offset) {
+        throw std::runtime_error("Metadata corrupta o truncada");
+    }
+    const uint64_t body_end = file_size - header.metadata_size;
     
-    if (decompressed.size() != header.total_uncompressed) {
+    std::vector<uint8_t> metadata(header.metadata_size);
+    in.seekg(body_end);
+    in.read(reinterpret_cast<char*>(metadata.data()), metadata.size());
+    if ((size_t)in.gcount() != metadata.size()) {
+        throw std::runtime_error("Metadata corrupta o truncada");
+    }
+    
+    SegmentedArchive archive;
+    archive.entries = deserializeMetadata(metadata.data(), metadata.size());
+    if (archive.entries.size() != header.num_files) {
+        throw std::runtime_error("Número de archivos no coincide con el header");
+    }
+    // Los archivos van uno tras otro en el concatenado
+    uint64_t expected = 0;
+    for (const auto& entry : archive.entries) {
+        if (entry.offset != expected || entry.size > header.total_uncompressed - expected) {
+            throw std::runtime_error("Metadata corrupta o truncada");
+        }
+        expected += entry.size;
+    }
+    
+    archive.frames = deflate_stream::readIndex(in, body_offset, body_end);
+    const uint64_t raw_total = archive.frames.empty()
+                                   ? 0 : archive.frames.back().raw_offset + archive.frames.back().raw_size;
+    if (expected != header.total_uncompressed || raw_total != header.total_uncompressed) {
         throw std::runtime_error("Tamaño descomprimido no coincide");
     }
+    return archive;
+}
+
+// Recibe el concatenado en orden desde el byte start y lo reparte en los archivos, uno
+// abierto a la vez. Con selected solo se escriben los archivos marcados: los bytes del
+// resto se saltean y lo que sobra al final del último frame se descarta.
+class SequentialWriter {
+public:
+    SequentialWriter(const std::string& output_folder, const std::vector<FileEntry>& entries,
+                     const std::vector<bool>* selected = nullptr, uint64_t start = 0)
+        : output_folder_(output_folder), entries_(entries), selected_(selected) {
+        // Archivo que contiene start (los offsets son contiguos y crecientes)
+        auto it = std::partition_point(entries_.begin(), entries_.end(),
+                                       [start](const FileEntry& e) { return e.offset < start; });
+        current_ = static_cast<size_t>(it - entries_.begin());
+        if (current_ > 0 && entries_[current_ - 1].offset + entries_[current_ - 1].size > start) {
+            --current_;
+            written_ = start - entries_[current_].offset;
+        }
+    }
+    
+    void write(const uint8_t* data, size_t size) {
+        while (current_ < entries_.size()) {
+            const FileEntry& entry = entries_[current_];
+            const bool keep = !selected_ || (*selected_)[current_];
+            if (keep && !out_.is_open()) {
+                fs::path output_path = fs::path(output_folder_) / entry.relative_path;
+                fs::create_directories(output_path.parent_path());
+                out_.open(output_path, std::ios::binary | std::ios::trunc);
+                if (!out_) throw std::runtime_error("No se pudo escribir: " + output_path.string());
+            }
+            const size_t take = static_cast<size_t>(std::min<uint64_t>(size, entry.size - written_));
+            if (keep) out_.write(reinterpret_cast<const char*>(data), take);
+            data += take;
+            size -= take;
+            written_ += take;
+            if (written_ < entry.size) return;
+            if (keep) {
+                out_.close();
+                if (!out_) throw std::runtime_error("No se pudo escribir: " + entry.relative_path);
+                ++files_written_;
+            }
+            ++current_;
+            written_ = 0;
+            // Extrayendo, el siguiente archivo pedido puede no estar en este tramo
+            if (selected_ && size == 0) return;
+        }
+        if (size > 0 && !selected_) throw std::runtime_error("Tamaño descomprimido no coincide");
+    }
+    
+    // Crea los archivos vacíos del final y verifica que no falte nada
+    void finish() {
+        write(nullptr, 0);
+        if (current_ != entries_.size()) throw std::runtime_error("Tamaño descomprimido no coincide");
+    }
+    
+    size_t filesWritten() const { return files_written_; }
+    
+private:
+    const std::string& output_folder_;
+    const std::vector<FileEntry>& entries_;
+    const std::vector<bool>* selected_;
+    size_t current_ = 0;
+    uint64_t written_ = 0;
+    size_t files_written_ = 0;
+    std::ofstream out_;
+};
+
+void decompressFolder(const std::string& input_file, const std::string& output_folder) {
+    std::ifstream in(input_file, std::ios::binary);
+    if (!in) throw std::runtime_error("No se pudo leer: " + input_file);
+    const ChupyDirHeader header = readDirHeader(in);
+    
+    if (header.version == CHUPYDIR_VERSION_SEGMENTS) {
+        // Frame a frame, con memoria acotada
+        const SegmentedArchive archive = openSegmented(in, header);
+        fs::create_directories(output_folder);
+        SequentialWriter writer(output_folder, archive.entries);
+        deflate_stream::decompressFrames(in, sizeof(ChupyDirHeader), archive.frames, 0, archive.frames.size(),
+                                         [&](const uint8_t* data, size_t size) { writer.write(data, size); });
+        writer.finish();
+        return;
+    }
+    
+    // Leer archivo completo
+    in.close();
+    auto file_data = readFileBinary(input_file);
+    std::vector<FileEntry> file_entries;
+    const std::vector<uint8_t> decompressed = decodeSolid(file_data, header, file_entries);
     
     // Crear carpeta de salida
     fs::create_directories(output_folder);
@@ -271,20 +769,9 @@ void decompressFolder(const std::string& input_file, const std::string& output_f
         const auto& entry = file_entries[i];
         
         try {
-            fs::path output_path = fs::path(output_folder) / entry.relative_path;
-            
-            // Crear subdirectorios si es necesario
-            fs::create_directories(output_path.parent_path());
-            
             // Extraer datos del archivo
             if (entry.offset + entry.size <= decompressed.size()) {
-                std::vector<uint8_t> file_data(
-                    decompressed.begin() + entry.offset,
-                    decompressed.begin() + entry.offset + entry.size
-                );
-                
-                // Escribir archivo
-                writeFileBinary(output_path.string(), file_data);
+                writeEntry(output_folder, entry, decompressed.data() + entry.offset);
             }
         } catch (...) {
             // Ignorar errores en archivos individuales
@@ -292,4 +779,86 @@ void decompressFolder(const std::string& input_file, const std::string& output_f
     }
 }
 
-} 
\ No newline at end of file
+// true si la ruta relativa del archivo es ruta o está dentro de la carpeta ruta
+static bool matchesPath(const std::string& relative_path, const std::string& ruta) {
+    if (relative_path.compare(0, ruta.size(), ruta) != 0) return false;
+    return relative_path.size() == ruta.size() || relative_path[ruta.size()] == '/';
+}
+
+size_t extractFiles(const std::string& input_file, const std::string& output_folder,
+                    const std::string& ruta) {
+    std::string wanted = fs::path(ruta).lexically_normal().generic_string();
+    while (wanted.size() > 1 && wanted.back() == '/') wanted.pop_back();
+    if (wanted.empty() || wanted == ".") {
+        throw std::runtime_error("Ruta a extraer vacía");
+    }
+    
+    std::ifstream in(input_file, std::ios::binary);
+    if (!in) throw std::runtime_error("No se pudo leer: " + input_file);
+    const ChupyDirHeader header = readDirHeader(in);
+    
+    size_t extracted = 0;
+    if (header.version != CHUPYDIR_VERSION_SEGMENTS) {
+        // Sin índice: hay que decodificar todo y escribir solo lo pedido
+        in.close();
+        auto file_data = readFileBinary(input_file);
+        std::vector<FileEntry> file_entries;
+        const std::vector<uint8_t> decompressed = decodeSolid(file_data, header, file_entries);
+        for (const auto& entry : file_entries) {
+            if (matchesPath(entry.relative_path, wanted) && entry.offset + entry.size <= decompressed.size()) {
+                writeEntry(output_folder, entry, decompressed.data() + entry.offset);
+                ++extracted;
+            }
+        }
+        return extracted;
+    }
+    
+    const SegmentedArchive archive = openSegmented(in, header);
+    const auto& entries = archive.entries;
+    // Los archivos vacíos no tienen frames: se crean directamente
+    std::vector<bool> selected(entries.size(), false);
+    size_t pending = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (!matchesPath(entries[i].relative_path, wanted)) continue;
+        if (entries[i].size == 0) {
+            writeEntry(output_folder, entries[i], nullptr);
+            ++extracted;
+        } else {
+            selected[i] = true;
+            ++pending;
+        }
+    }
+    
+    // Los frames de archivos pedidos que se tocan o se solapan se decodifican en un solo
+    // tramo (sin repetir frames) y van directo a disco: la memoria no depende del tamaño
+    // de lo extraído
+    for (size_t i = 0; i < entries.size();) {
+        if (!selected[i]) {
+            ++i;
+            continue;
+        }
+        size_t first, last;
+        deflate_stream::coveringFrames(archive.frames, entries[i].offset, entries[i].offset + entries[i].size,
+                                       first, last);
+        size_t next = i + 1;
+        for (; next < entries.size(); ++next) {
+            if (!selected[next]) continue;
+            size_t next_first, next_last;
+            deflate_stream::coveringFrames(archive.frames, entries[next].offset,
+                                           entries[next].offset + entries[next].size, next_first, next_last);
+            if (next_first > last) break;
+            last = std::max(last, next_last);
+        }
+        
+        SequentialWriter writer(output_folder, entries, &selected, archive.frames[first].raw_offset);
+        deflate_stream::decompressFrames(in, sizeof(ChupyDirHeader), archive.frames, first, last,
+                                         [&](const uint8_t* data, size_t size) { writer.write(data, size); });
+        extracted += writer.filesWritten();
+        pending -= std::min(pending, writer.filesWritten());
+        i = next;
+    }
+    if (pending != 0) throw std::runtime_error("Tamaño descomprimido no coincide");
+    return extracted;
+}
+
+}
@@ -5,6 +5,7 @@
 #include <vector>
 #include <cstdint>
 #include <cstring>
+#include "deflate_interface.h"
 
 namespace FolderCompressor {
 
@@ -19,6 +20,21 @@ struct FileEntry {
         : relative_path(path), offset(off), size(sz) {}
 };
 
+// Versiones del .chupydir: la 1 y la 2 guardan el stream de bytes de LZ77 (la 2 con
+// ventana larga); la 3 guarda tokens separados (lz77_tokens, con cualquier ventana).
+// La 4 es como la 3 pero los archivos incompresibles van al final sin comprimir:
+// [u64 tamaño de los tokens][tokens][archivos guardados tal cual]
+constexpr uint32_t CHUPYDIR_VERSION_CLASSIC = 1;
+constexpr uint32_t CHUPYDIR_VERSION_WIDE    = 2;
+constexpr uint32_t CHUPYDIR_VERSION_TOKENS  = 3;
+constexpr uint32_t CHUPYDIR_VERSION_STORED  = 4;
+// La 5 parte los archivos concatenados en frames independientes de deflate_stream
+// (como el .chupy v3) y deja la metadata al final:
+// [header][frames][FRAME_END][índice de frames][metadata (metadata_size bytes)]
+// Los offsets de FileEntry son posiciones en el concatenado sin comprimir; con el
+// índice se decodifican solo los frames de los archivos pedidos.
+constexpr uint32_t CHUPYDIR_VERSION_SEGMENTS = 5;
+
 // Header del archivo .chupydir
 struct ChupyDirHeader {
     char magic[8];              // "CHUPYDIR"
@@ -29,7 +45,7 @@ struct ChupyDirHeader {
     
     ChupyDirHeader() {
         memcpy(magic, "CHUPYDIR", 8);
-        version = 1;
+        version = CHUPYDIR_VERSION_CLASSIC;
         num_files = 0;
         total_uncompressed = 0;
         metadata_size = 0;
@@ -40,12 +56,21 @@ struct ChupyDirHeader {
     }
 };
 
+// Mínimo aceptado para --max-memory: un frame en vuelo y las dos colas del pipeline
+constexpr int MIN_MAX_MEMORY_MIB = 32;
+
 // Función principal: comprimir una carpeta completa
-void compressFolder(const std::string& folder_path, const std::string& output_file);
+void compressFolder(const std::string& folder_path, const std::string& output_file,
+                    const OpcionesCompresion& opciones = OpcionesCompresion());
 
 // Función principal: descomprimir un archivo .chupydir
 void decompressFolder(const std::string& input_file, const std::string& output_folder);
 
+// Extrae solo los archivos cuya ruta relativa es ruta o está dentro de la carpeta
+// ruta; devuelve cuántos extrajo. En v5 solo decodifica los frames que los cubren.
+size_t extractFiles(const std::string& input_file, const std::string& output_folder,
+                    const std::string& ruta);
+
 // Utilidades internas (públicas por si necesitas usarlas)
 std::vector<uint8_t> serializeMetadata(const std::vector<FileEntry>& entries);
 std::vector<FileEntry> deserializeMetadata(const uint8_t* data, size_t size);
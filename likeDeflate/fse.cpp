@@ -0,0 +1,386 @@
+#include "fse.h"
+#include "histogram.h"
+#include "huffman.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace fse {
+
+// ---------- util ----------
+
+static constexpr size_t HEADER_SIZE = 10;   // [u16 0][u8 tipo][u16 alfabeto][u32 símbolos][u8 table_log]
+
+static void putU16(std::vector<uint8_t>& out, uint16_t v) {
+    out.push_back((uint8_t)(v & 0xFF));
+    out.push_back((uint8_t)(v >> 8));
+}
+
+static void putU32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int k = 0; k < 4; ++k) out.push_back((uint8_t)(v >> (8 * k)));
+}
+
+static uint16_t getU16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+static uint32_t getU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline int highbit(uint32_t v) { return 31 - __builtin_clz(v); }
+
+// ---------- frecuencias normalizadas ----------
+
+// Tamaño de tabla: más estados dan más precisión pero agrandan la cabecera, y nunca
+// menos del doble de símbolos usados (todos necesitan al menos un estado)
+static int chooseTableLog(size_t count, uint32_t used) {
+    int log = DEFAULT_TABLE_LOG;
+    if (count > 1) log = std::min(log, highbit((uint32_t)std::min<size_t>(count - 1, UINT32_MAX)) - 2);
+    const int min_log = (used > 1) ? highbit(used - 1) + 2 : MIN_TABLE_LOG;
+    log = std::max({log, min_log, MIN_TABLE_LOG});
+    if (log > MAX_TABLE_LOG) throw std::runtime_error("fse: alfabeto demasiado grande");
+    return log;
+}
+
+// Reparte 2^table_log estados en proporción a freq; todo símbolo usado recibe al menos
+// uno. El redondeo se corrige de a un estado donde menos cambia el costo total
+// (freq * log2(1/p)).
+static std::vector<uint16_t> normalizeCounts(const std::vector<uint32_t>& freq, uint64_t total,
+                                             int table_log) {
+    const int64_t table_size = int64_t(1) << table_log;
+    std::vector<uint16_t> norm(freq.size(), 0);
+    int64_t sum = 0;
+    for (size_t s = 0; s < freq.size(); ++s) {
+        if (!freq[s]) continue;
+        uint64_t n = ((uint64_t)freq[s] * (uint64_t)table_size + total / 2) / total;
+        norm[s] = (uint16_t)std::max<uint64_t>(n, 1);
+        sum += norm[s];
+    }
+
+    while (sum != table_size) {
+        int best = -1;
+        double best_delta = 0.0;
+        for (size_t s = 0; s < freq.size(); ++s) {
+            if (!freq[s]) continue;
+            if (sum < table_size) {
+                // lo que se ahorra al sumarle un estado
+                double gain = freq[s] * std::log2((norm[s] + 1.0) / norm[s]);
+                if (best < 0 || gain > best_delta) { best = (int)s; best_delta = gain; }
+            } else if (norm[s] > 1) {
+                // lo que se pierde al quitarle uno
+                double loss = freq[s] * std::log2((double)norm[s] / (norm[s] - 1.0));
+                if (best < 0 || loss < best_delta) { best = (int)s; best_delta = loss; }
+            }
+        }
+        if (sum < table_size) { norm[best]++; sum++; }
+        else                  { norm[best]--; sum--; }
+    }
+    return norm;
+}
+
+// Gamma de Elias (v >= 1): n ceros, un 1 y los n bits bajos de v
+static void writeGamma(huff::BitWriter& bw, uint32_t v) {
+    const int n = highbit(v);
+    bw.writeBits(0, n);
+    bw.writeBits(1, 1);
+    bw.writeBits(v, n);
+}
+
+static uint32_t readGamma(huff::BitReader& br) {
+    int n = 0;
+    while (br.readBits(1) == 0) {
+        if (++n > 24) throw std::runtime_error("fse: cabecera inválida");
+    }
+    return (1u << n) | (n ? br.readBits(n) : 0);
+}
+
+// Cada frecuencia como gamma(norm + 1); después de un cero, gamma(ceros que siguen + 1).
+// Se corta al completar 2^table_log: el resto del alfabeto queda en cero.
+static void writeNormalized(huff::BitWriter& bw, const std::vector<uint16_t>& norm, int table_log) {
+    const uint32_t table_size = 1u << table_log;
+    uint32_t sum = 0;
+    for (size_t s = 0; sum < table_size; ++s) {
+        writeGamma(bw, norm[s] + 1u);
+        sum += norm[s];
+        if (norm[s] == 0) {
+            size_t run = 0;
+            while (s + 1 + run < norm.size() && norm[s + 1 + run] == 0) ++run;
+            writeGamma(bw, (uint32_t)run + 1);
+            s += run;
+        }
+    }
+}
+
+static std::vector<uint16_t> readNormalized(huff::BitReader& br, uint32_t alphabet_size, int table_log) {
+    const uint32_t table_size = 1u << table_log;
+    std::vector<uint16_t> norm(alphabet_size, 0);
+    uint32_t sum = 0;
+    for (size_t s = 0; sum < table_size; ++s) {
+        if (s >= alphabet_size) throw std::runtime_error("fse: frecuencias inválidas");
+        uint32_t v = readGamma(br) - 1;
+        if (v > table_size - sum) throw std::runtime_error("fse: frecuencias inválidas");
+        norm[s] = (uint16_t)v;
+        sum += v;
+        if (v == 0) {
+            uint32_t run = readGamma(br) - 1;
+            if (s + 1 + run > alphabet_size) throw std::runtime_error("fse: frecuencias inválidas");
+            s += run;
+        }
+    }
+    if (br.overrun()) throw std::runtime_error("fse: cabecera truncada");
+    return norm;
+}
+
+// ---------- tablas ----------
+
+// Reparte los estados de cada símbolo por toda la tabla con un paso coprimo con su
+// tamaño, así los estados de un símbolo quedan intercalados con los del resto
+static std::vector<uint16_t> spreadSymbols(const std::vector<uint16_t>& norm, int table_log) {
+    const uint32_t table_size = 1u << table_log;
+    const uint32_t mask = table_size - 1;
+    const uint32_t step = (table_size >> 1) + (table_size >> 3) + 3;
+    std::vector<uint16_t> table_symbol(table_size);
+    uint32_t pos = 0;
+    for (size_t s = 0; s < norm.size(); ++s) {
+        for (uint32_t i = 0; i < norm[s]; ++i) {
+            table_symbol[pos] = (uint16_t)s;
+            pos = (pos + step) & mask;
+        }
+    }
+    return table_symbol;
+}
+
+struct EncodeSymbol {
+    uint32_t delta_nb_bits;     // (bits << 16) - estado mínimo que emite esos bits
+    int32_t  delta_find_state;  // desplazamiento dentro de state_table
+};
+
+struct EncodeTable {
+    std::vector<uint16_t> state_table;   // estados destino (table_size + posición)
+    std::vector<EncodeSymbol> symbols;
+};
+
+static EncodeTable buildEncodeTable(const std::vector<uint16_t>& norm, int table_log) {
+    const uint32_t table_size = 1u << table_log;
+    const auto table_symbol = spreadSymbols(norm, table_log);
+
+    EncodeTable ct;
+    ct.state_table.resize(table_size);
+    std::vector<uint32_t> cumul(norm.size() + 1, 0);
+    for (size_t s = 0; s < norm.size(); ++s) cumul[s + 1] = cumul[s] + norm[s];
+    for (uint32_t u = 0; u < table_size; ++u) {
+        ct.state_table[cumul[table_symbol[u]]++] = (uint16_t)(table_size + u);
+    }
+
+    ct.symbols.resize(norm.size());
+    int32_t total = 0;
+    for (size_t s = 0; s < norm.size(); ++s) {
+        auto& e = ct.symbols[s];
+        if (norm[s] == 0) continue;
+        if (norm[s] == 1) {
+            e.delta_nb_bits = ((uint32_t)table_log << 16) - table_size;
+            e.delta_find_state = total - 1;
+        } else {
+            const uint32_t max_bits_out = (uint32_t)(table_log - highbit(norm[s] - 1u));
+            const uint32_t min_state_plus = (uint32_t)norm[s] << max_bits_out;
+            e.delta_nb_bits = (max_bits_out << 16) - min_state_plus;
+            e.delta_find_state = total - norm[s];
+        }
+        total += norm[s];
+    }
+    return ct;
+}
+
+struct DecodeEntry {
+    uint16_t new_state;   // base del estado siguiente (se le suman los bits leídos)
+    uint16_t symbol;
+    uint8_t  nb_bits;
+};
+
+static std::vector<DecodeEntry> buildDecodeTable(const std::vector<uint16_t>& norm, int table_log) {
+    const uint32_t table_size = 1u << table_log;
+    const auto table_symbol = spreadSymbols(norm, table_log);
+    std::vector<uint32_t> next(norm.begin(), norm.end());
+    std::vector<DecodeEntry> dt(table_size);
+    for (uint32_t u = 0; u < table_size; ++u) {
+        const uint16_t s = table_symbol[u];
+        const uint32_t x = next[s]++;
+        const int nb = table_log - highbit(x);
+        dt[u].symbol = s;
+        dt[u].nb_bits = (uint8_t)nb;
+        dt[u].new_state = (uint16_t)((x << nb) - table_size);
+    }
+    return dt;
+}
+
+// Lee el bitstream desde el final: cada read devuelve los nbits escritos justo antes
+// de los que ya se leyeron. Los bits pendientes están en la parte alta de container_;
+// refill lo recarga desde memoria cuando se consumieron bytes enteros.
+class BackwardReader {
+public:
+    BackwardReader(const uint8_t* data, size_t size) : start_(data) {
+        if (size == 0 || data[size - 1] == 0) throw std::runtime_error("fse: bitstream sin cierre");
+        // Se saltea el relleno en cero y el bit 1 de cierre del último byte
+        consumed_ = 8 - highbit(data[size - 1]);
+        if (size >= 8) {
+            ptr_ = data + size - 8;
+            std::memcpy(&container_, ptr_, 8);
+        } else {
+            ptr_ = data;
+            container_ = 0;
+            for (size_t k = 0; k < size; ++k) container_ |= (uint64_t)data[k] << (8 * k);
+            // Los bytes que faltan cuentan como ya leídos
+            consumed_ += (unsigned)(8 * (8 - size));
+        }
+    }
+
+    uint32_t read(unsigned nbits) {
+        const uint64_t v = ((container_ << (consumed_ & 63)) >> 1) >> (63 - nbits);
+        consumed_ += nbits;
+        return (uint32_t)v;
+    }
+
+    // Recarga; devuelve true si quedan al menos 48 bits en el container
+    bool refill() {
+        if (consumed_ > 64) throw std::runtime_error("fse: bitstream truncado");
+        if (ptr_ >= start_ + 8) {
+            ptr_ -= consumed_ >> 3;
+            consumed_ &= 7;
+        } else if (ptr_ > start_) {
+            size_t bytes = std::min<size_t>(consumed_ >> 3, (size_t)(ptr_ - start_));
+            ptr_ -= bytes;
+            consumed_ -= (unsigned)(bytes * 8);
+        } else {
+            return consumed_ <= 16;
+        }
+        std::memcpy(&container_, ptr_, 8);
+        return consumed_ <= 16;
+    }
+
+    // true si se consumieron exactamente todos los bits
+    bool finished() const { return ptr_ == start_ && consumed_ == 64; }
+
+private:
+    const uint8_t* start_;
+    const uint8_t* ptr_;
+    uint64_t container_;
+    unsigned consumed_;   // bits ya leídos desde el tope de container_
+};
+
+// ---------- API ----------
+
+template <typename Sym>
+std::vector<uint8_t> encodeStream(const Sym* symbols, size_t count, uint32_t alphabetSize) {
+    if (alphabetSize > 0xFFFF) throw std::runtime_error("fse: alfabeto demasiado grande");
+    std::vector<uint8_t> out;
+    putU16(out, 0);
+    out.push_back(STREAM_FSE);
+    putU16(out, (uint16_t)alphabetSize);
+    putU32(out, (uint32_t)count);
+    if (count == 0) {
+        out.push_back(0);
+        return out;
+    }
+
+    std::vector<uint32_t> freq(alphabetSize, 0);
+    if (!histogram::count(symbols, count, alphabetSize, freq.data())) {
+        throw std::runtime_error("fse: símbolo fuera del alfabeto");
+    }
+    uint32_t used = 0;
+    for (uint32_t f : freq) used += (f != 0);
+    const int table_log = chooseTableLog(count, used);
+    const uint32_t table_size = 1u << table_log;
+    const auto norm = normalizeCounts(freq, count, table_log);
+    out.push_back((uint8_t)table_log);
+
+    huff::BitWriter header;
+    writeNormalized(header, norm, table_log);
+    header.flushZeroPadding();
+    out.insert(out.end(), header.data().begin(), header.data().end());
+
+    // Símbolos de atrás hacia adelante; el decoder los recupera en orden
+    const EncodeTable ct = buildEncodeTable(norm, table_log);
+    huff::BitWriter bw;
+    bw.reserve(count / 2 + 16);
+    uint32_t state[2] = {table_size, table_size};
+    for (size_t i = count; i-- > 0;) {
+        uint32_t& st = state[i & 1];
+        const EncodeSymbol& e = ct.symbols[symbols[i]];
+        const uint32_t nb = (st + e.delta_nb_bits) >> 16;
+        bw.writeBits(st, (int)nb);
+        st = ct.state_table[(st >> nb) + e.delta_find_state];
+    }
+    bw.writeBits(state[1] - table_size, table_log);
+    bw.writeBits(state[0] - table_size, table_log);
+    bw.writeBits(1, 1);
+    bw.flushZeroPadding();
+    out.insert(out.end(), bw.data().begin(), bw.data().end());
+    return out;
+}
+
+bool isFseStream(const uint8_t* data, size_t size) {
+    return size >= 3 && getU16(data) == 0 && data[2] == STREAM_FSE;
+}
+
+size_t decodedSymbolCount(const uint8_t* data, size_t size) {
+    if (!isFseStream(data, size) || size < HEADER_SIZE) throw std::runtime_error("fse: cabecera truncada");
+    return getU32(data + 5);
+}
+
+template <typename Sym>
+size_t decodeStreamInto(const uint8_t* data, size_t size, Sym* out, size_t capacity) {
+    const size_t count = decodedSymbolCount(data, size);
+    const uint32_t alphabet_size = getU16(data + 3);
+    const int table_log = data[9];
+    if (count > capacity) throw std::runtime_error("fse: la salida no cabe en el buffer");
+    if (count == 0) return 0;
+    if ((uint64_t)alphabet_size > (uint64_t)std::numeric_limits<Sym>::max() + 1) {
+        throw std::runtime_error("fse: alfabeto demasiado grande para el tipo de símbolo");
+    }
+    if (table_log < MIN_TABLE_LOG || table_log > MAX_TABLE_LOG) {
+        throw std::runtime_error("fse: table_log inválido");
+    }
+
+    huff::BitReader hr(data + HEADER_SIZE, size - HEADER_SIZE);
+    const auto norm = readNormalized(hr, alphabet_size, table_log);
+    const size_t offset = HEADER_SIZE + hr.bytesConsumed();
+    if (offset > size) throw std::runtime_error("fse: cabecera truncada");
+    const auto dt = buildDecodeTable(norm, table_log);
+
+    BackwardReader br(data + offset, size - offset);
+    uint32_t s0 = br.read(table_log);
+    uint32_t s1 = br.read(table_log);
+    auto step = [&](uint32_t& state, Sym& out_sym) {
+        const DecodeEntry& e = dt[state];
+        out_sym = (Sym)e.symbol;
+        state = e.new_state + br.read(e.nb_bits);
+    };
+
+    // 4 símbolos de hasta 12 bits entran en los 48 bits que garantiza refill
+    size_t i = 0;
+    while (i + 4 <= count && br.refill()) {
+        step(s0, out[i]);
+        step(s1, out[i + 1]);
+        step(s0, out[i + 2]);
+        step(s1, out[i + 3]);
+        i += 4;
+    }
+    for (; i < count; ++i) {
+        br.refill();
+        step((i & 1) ? s1 : s0, out[i]);
+    }
+    br.refill();
+    // El encoder arrancó los dos estados en 0: cualquier otro final es un stream roto
+    if (!br.finished() || s0 != 0 || s1 != 0) throw std::runtime_error("fse: stream corrupto");
+    return count;
+}
+
+template std::vector<uint8_t> encodeStream<uint8_t>(const uint8_t*, size_t, uint32_t);
+template std::vector<uint8_t> encodeStream<uint16_t>(const uint16_t*, size_t, uint32_t);
+template std::vector<uint8_t> encodeStream<uint32_t>(const uint32_t*, size_t, uint32_t);
+template size_t decodeStreamInto<uint8_t>(const uint8_t*, size_t, uint8_t*, size_t);
+template size_t decodeStreamInto<uint16_t>(const uint8_t*, size_t, uint16_t*, size_t);
+template size_t decodeStreamInto<uint32_t>(const uint8_t*, size_t, uint32_t*, size_t);
+
+} // namespace fse
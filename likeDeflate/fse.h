@@ -0,0 +1,48 @@
+#ifndef FSE_H
+#define FSE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Codificador de entropía tANS (asymmetric numeral systems con tablas, estilo FSE).
+//
+// Huffman redondea cada símbolo a bits enteros; tANS reparte 2^table_log estados entre
+// los símbolos en proporción a su frecuencia y cada símbolo cuesta log2(1/p) bits con
+// precisión fraccional. Gana en distribuciones sesgadas (literales de texto, longitudes
+// cortas) y el decoder sigue siendo una lectura de tabla por símbolo.
+//
+// El encoder recorre los símbolos al revés y escribe los bits hacia adelante; el decoder
+// lee ese bitstream desde el final. Dos estados intercalados (símbolo i con el estado
+// i % 2) dan dos cadenas de dependencia independientes.
+//
+// Formato (usa el escape de alphabet_size 0 de los streams de huffman.h):
+//   [u16 0][u8 STREAM_FSE][u16 alphabet_size][u32 num_symbols][u8 table_log]
+//   [frecuencias normalizadas, ver fse.cpp][bitstream: bits de símbolos, estado 1,
+//    estado 0 y un bit 1 de cierre; se lee desde el final]
+
+namespace fse {
+
+constexpr uint8_t STREAM_FSE        = 0x80;
+constexpr int     MIN_TABLE_LOG     = 5;
+constexpr int     MAX_TABLE_LOG     = 12;
+constexpr int     DEFAULT_TABLE_LOG = 11;
+
+// Codifica count símbolos menores que alphabetSize. Instanciada para uint8_t, uint16_t
+// y uint32_t.
+template <typename Sym>
+std::vector<uint8_t> encodeStream(const Sym* symbols, size_t count, uint32_t alphabetSize);
+
+// true si data empieza con la cabecera de un stream FSE
+bool isFseStream(const uint8_t* data, size_t size);
+
+// Cantidad de símbolos del stream (para dimensionar el buffer de salida)
+size_t decodedSymbolCount(const uint8_t* data, size_t size);
+
+// Decodifica en out (capacity símbolos) y devuelve cuántos escribió
+template <typename Sym>
+size_t decodeStreamInto(const uint8_t* data, size_t size, Sym* out, size_t capacity);
+
+} // namespace fse
+
+#endif
@@ -0,0 +1,112 @@
+#include "histogram.h"
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include <omp.h>
+
+namespace histogram {
+
+// Bytes en un hilo: lecturas de 8 bytes y un byte a cada subtabla por turno
+static bool countBytesRange(const uint8_t* data, size_t size, uint32_t* hist) {
+    static_assert(SUBTABLES == 4, "el desenrollado asume 4 subtablas");
+    uint32_t t[SUBTABLES][256] = {};
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        uint64_t a, b;
+        std::memcpy(&a, data + i, 8);
+        std::memcpy(&b, data + i + 8, 8);
+        t[0][(uint8_t)a]++;
+        t[1][(uint8_t)(a >> 8)]++;
+        t[2][(uint8_t)(a >> 16)]++;
+        t[3][(uint8_t)(a >> 24)]++;
+        t[0][(uint8_t)(a >> 32)]++;
+        t[1][(uint8_t)(a >> 40)]++;
+        t[2][(uint8_t)(a >> 48)]++;
+        t[3][(uint8_t)(a >> 56)]++;
+        t[0][(uint8_t)b]++;
+        t[1][(uint8_t)(b >> 8)]++;
+        t[2][(uint8_t)(b >> 16)]++;
+        t[3][(uint8_t)(b >> 24)]++;
+        t[0][(uint8_t)(b >> 32)]++;
+        t[1][(uint8_t)(b >> 40)]++;
+        t[2][(uint8_t)(b >> 48)]++;
+        t[3][(uint8_t)(b >> 56)]++;
+    }
+    for (; i < size; ++i) t[i % SUBTABLES][data[i]]++;
+
+    for (int s = 0; s < 256; ++s) hist[s] += t[0][s] + t[1][s] + t[2][s] + t[3][s];
+    return true;
+}
+
+// Símbolos genéricos en un hilo. Cada subtabla tiene un contador extra donde caen los
+// símbolos fuera de rango, así el chequeo no agrega saltos al bucle.
+template <typename Sym>
+static bool countSymbolsRange(const Sym* data, size_t size, uint32_t alphabetSize, uint32_t* hist) {
+    const size_t slots = (size_t)alphabetSize + 1;
+    std::vector<uint32_t> t(SUBTABLES * slots, 0);
+    uint32_t* t0 = t.data();
+    uint32_t* t1 = t0 + slots;
+    uint32_t* t2 = t1 + slots;
+    uint32_t* t3 = t2 + slots;
+    auto slot = [alphabetSize](uint32_t s) { return s < alphabetSize ? s : alphabetSize; };
+
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        t0[slot(data[i])]++;
+        t1[slot(data[i + 1])]++;
+        t2[slot(data[i + 2])]++;
+        t3[slot(data[i + 3])]++;
+    }
+    for (; i < size; ++i) t[(i % SUBTABLES) * slots + slot(data[i])]++;
+
+    for (uint32_t s = 0; s < alphabetSize; ++s) hist[s] += t0[s] + t1[s] + t2[s] + t3[s];
+    return t0[alphabetSize] + t1[alphabetSize] + t2[alphabetSize] + t3[alphabetSize] == 0;
+}
+
+template <typename Sym>
+static bool countRange(const Sym* data, size_t size, uint32_t alphabetSize, uint32_t* hist) {
+    if constexpr (std::is_same<Sym, uint8_t>::value) {
+        if (alphabetSize >= 256) return countBytesRange(data, size, hist);
+    }
+    return countSymbolsRange(data, size, alphabetSize, hist);
+}
+
+template <typename Sym>
+bool count(const Sym* data, size_t size, uint32_t alphabetSize, uint32_t* hist) {
+    // En el byte-path los contadores de 256..alphabetSize-1 quedan en cero
+    const uint32_t counted = (std::is_same<Sym, uint8_t>::value && alphabetSize > 256) ? 256 : alphabetSize;
+    const int threads = omp_get_max_threads();
+    if (size < PARALLEL_THRESHOLD || threads < 2 || omp_in_parallel()) {
+        return countRange(data, size, counted, hist);
+    }
+
+    // Un tramo por hilo con su propio histograma; se suman al final sin secciones críticas
+    std::vector<uint32_t> partial((size_t)threads * counted, 0);
+    std::vector<uint8_t> ok(threads, 1);
+#pragma omp parallel num_threads(threads)
+    {
+        const int t = omp_get_thread_num();
+        const int nt = omp_get_num_threads();
+        const size_t begin = size * t / nt;
+        const size_t end = size * (t + 1) / nt;
+        ok[t] = countRange(data + begin, end - begin, counted, &partial[(size_t)t * counted]);
+    }
+
+    bool all_ok = true;
+    for (int t = 0; t < threads; ++t) {
+        const uint32_t* p = &partial[(size_t)t * counted];
+        for (uint32_t s = 0; s < counted; ++s) hist[s] += p[s];
+        all_ok = all_ok && ok[t];
+    }
+    return all_ok;
+}
+
+void countBytes(const uint8_t* data, size_t size, uint32_t* hist) {
+    count(data, size, 256, hist);
+}
+
+template bool count<uint8_t>(const uint8_t*, size_t, uint32_t, uint32_t*);
+template bool count<uint16_t>(const uint16_t*, size_t, uint32_t, uint32_t*);
+template bool count<uint32_t>(const uint32_t*, size_t, uint32_t, uint32_t*);
+
+} // namespace histogram
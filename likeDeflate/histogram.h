@@ -0,0 +1,32 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Histogramas de símbolos (frecuencias para Huffman, entropía del probe).
+//
+// El conteo ingenuo hist[s]++ se frena en las tiradas: cada incremento espera al store
+// del anterior sobre el mismo contador. Acá se cuenta sobre SUBTABLES subtablas
+// intercaladas (el símbolo i va a la subtabla i % SUBTABLES) y al final se suman, así
+// símbolos consecutivos iguales tocan contadores distintos. Los bytes se leen de a 8.
+// Desde PARALLEL_THRESHOLD símbolos cada hilo de OpenMP cuenta un tramo por su cuenta;
+// por debajo no compensa levantar los hilos.
+
+namespace histogram {
+
+constexpr int    SUBTABLES          = 4;
+constexpr size_t PARALLEL_THRESHOLD = 1 << 20;   // símbolos
+
+// hist[0..255] += apariciones de cada byte
+void countBytes(const uint8_t* data, size_t size, uint32_t* hist);
+
+// hist[0..alphabetSize-1] += apariciones de cada símbolo. Devuelve false si algún
+// símbolo es >= alphabetSize (esos no se cuentan). Instanciada para uint8_t, uint16_t
+// y uint32_t.
+template <typename Sym>
+bool count(const Sym* data, size_t size, uint32_t alphabetSize, uint32_t* hist);
+
+} // namespace histogram
+
+#endif
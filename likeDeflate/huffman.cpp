@@ -1,5 +1,5 @@
 #include "huffman.h"
-#include <queue>
+#include "histogram.h"
 #include <algorithm>
 #include <limits>
 #include <cstring>
@@ -21,92 +21,165 @@ namespace huff
         return r;
     }
 
-    // ---------- construir longitudes (heap + DFS iterativo) ----------
+    // ---------- construir longitudes ----------
 
-    struct Node
+    // Moffat-Katajainen: longitudes de Huffman sin límite, en el lugar y en tiempo lineal.
+    // A llega con los pesos en orden ascendente (n >= 2) y sale con la longitud de cada uno.
+    // Primero A guarda pesos y punteros al padre de los nodos internos, después profundidades.
+    static void minimumRedundancyLengths(std::vector<uint64_t> &A)
     {
-        uint32_t sym;
-        uint32_t freq;
-        int left = -1, right = -1;
-    };
-
-    static std::vector<uint8_t> buildCodeLengths(const std::vector<uint32_t> &freq, uint8_t maxLen)
-    {
-        const uint32_t N = (uint32_t)freq.size();
-        // si todo cero -> un símbolo con longitud 1
-        bool allZero = true;
-        for (auto v : freq)
-            if (v)
+        const long n = (long)A.size();
+        long root = 0, leaf = 2;
+        A[0] += A[1];
+        for (long next = 1; next < n - 1; ++next)
+        {
+            // primer elemento del par: nodo interno o la próxima hoja
+            if (leaf >= n || A[root] < A[leaf])
             {
-                allZero = false;
-                break;
+                A[next] = A[root];
+                A[root++] = (uint64_t)next;
+            }
+            else
+            {
+                A[next] = A[leaf++];
+            }
+            // segundo elemento
+            if (leaf >= n || (root < next && A[root] < A[leaf]))
+            {
+                A[next] += A[root];
+                A[root++] = (uint64_t)next;
+            }
+            else
+            {
+                A[next] += A[leaf++];
             }
-        if (allZero)
-        {
-            std::vector<uint8_t> len(N, 0);
-            if (N)
-                len[0] = 1;
-            return len;
         }
 
-        struct QItem
-        {
-            uint32_t f;
-            int idx;
-            bool operator>(const QItem &o) const { return f > o.f; }
-        };
-        std::priority_queue<QItem, std::vector<QItem>, std::greater<QItem>> pq;
-        std::vector<Node> nodes;
-        nodes.reserve(2 * N);
+        // profundidad de los nodos internos, de la raíz hacia abajo
+        A[n - 2] = 0;
+        for (long next = n - 3; next >= 0; --next)
+            A[next] = A[A[next]] + 1;
 
-        for (uint32_t i = 0; i < N; ++i)
-            if (freq[i])
+        // profundidad de las hojas: en cada nivel, los lugares libres que no ocupan nodos
+        // internos son hojas (las más pesadas primero)
+        long avail = 1, used = 0, next = n - 1;
+        uint64_t depth = 0;
+        root = n - 2;
+        while (avail > 0)
+        {
+            while (root >= 0 && A[root] == depth)
+            {
+                ++used;
+                --root;
+            }
+            while (avail > used)
             {
-                nodes.push_back(Node{i, freq[i], -1, -1});
-                pq.push(QItem{freq[i], (int)nodes.size() - 1});
+                A[next--] = depth;
+                --avail;
             }
-        if (pq.size() == 1)
+            avail = 2 * used;
+            ++depth;
+            used = 0;
+        }
+    }
+
+    // Package-merge de Larmore-Hirschberg: la lista del nivel 1 son las hojas ordenadas por
+    // frecuencia; cada nivel siguiente mezcla las hojas con los pares (paquetes) de la lista
+    // anterior. De la lista del nivel maxLen se toman los 2n-2 elementos más livianos y la
+    // longitud de cada símbolo es la cantidad de niveles en que su hoja queda elegida.
+    // Solo se guarda, por nivel, qué posiciones de la lista son hojas: O(n * maxLen).
+    static void packageMergeLengths(const std::vector<uint64_t> &leaves, uint8_t maxLen,
+                                    std::vector<uint8_t> &lengths)
+    {
+        const size_t n = leaves.size();
+        const size_t width = 2 * n;   // ninguna lista pasa de n hojas + n paquetes
+        std::vector<uint8_t> isLeaf((size_t)maxLen * width, 1);
+        std::vector<uint64_t> list(width), next(width);
+        std::copy(leaves.begin(), leaves.end(), list.begin());
+        size_t listSize = n;
+        for (int level = 1; level < maxLen; ++level)
         {
-            std::vector<uint8_t> len(N, 0);
-            len[nodes[pq.top().idx].sym] = 1;
-            return len;
+            uint8_t *flags = &isLeaf[(size_t)level * width];
+            const size_t packages = listSize / 2;
+            size_t li = 0, pi = 0, k = 0;
+            while (li < n || pi < packages)
+            {
+                // Entre iguales va primero la hoja
+                const uint64_t pkg = (pi < packages) ? list[2 * pi] + list[2 * pi + 1] : 0;
+                if (pi == packages || (li < n && leaves[li] <= pkg))
+                {
+                    next[k] = leaves[li++];
+                    flags[k++] = 1;
+                }
+                else
+                {
+                    next[k] = pkg;
+                    ++pi;
+                    flags[k++] = 0;
+                }
+            }
+            listSize = k;
+            list.swap(next);
         }
-        while (pq.size() >= 2)
+
+        lengths.assign(n, 0);
+        size_t take = 2 * n - 2;
+        for (int level = maxLen - 1; level >= 0 && take > 0; --level)
         {
-            auto a = pq.top();
-            pq.pop();
-            auto b = pq.top();
-            pq.pop();
-            nodes.push_back(Node{(uint32_t)-1, a.f + b.f, a.idx, b.idx});
-            pq.push(QItem{a.f + b.f, (int)nodes.size() - 1});
+            const uint8_t *flags = &isLeaf[(size_t)level * width];
+            size_t leafCount = 0;
+            for (size_t i = 0; i < take; ++i)
+                leafCount += flags[i];
+            // Las hojas de cada lista están en orden: las elegidas son las leafCount primeras
+            for (size_t i = 0; i < leafCount; ++i)
+                lengths[i]++;
+            take = 2 * (take - leafCount);
         }
-        int root = pq.top().idx;
+    }
 
-        // DFS iterativo para obtener profundidades
+    static std::vector<uint8_t> buildCodeLengths(const std::vector<uint32_t> &freq, uint8_t maxLen,
+                                                 LengthLimit limit)
+    {
+        const uint32_t N = (uint32_t)freq.size();
         std::vector<uint8_t> codeLen(N, 0);
-        struct Frame
+
+        // Símbolos usados, por frecuencia ascendente
+        std::vector<uint32_t> syms;
+        for (uint32_t s = 0; s < N; ++s)
+            if (freq[s])
+                syms.push_back(s);
+        // si todo cero -> un símbolo con longitud 1; uno solo también lleva 1 bit
+        if (syms.size() <= 1)
         {
-            int u;
-            int depth;
-        };
-        std::vector<Frame> st;
-        st.push_back({root, 0});
-        while (!st.empty())
+            if (N)
+                codeLen[syms.empty() ? 0 : syms[0]] = 1;
+            return codeLen;
+        }
+        std::stable_sort(syms.begin(), syms.end(),
+                         [&](uint32_t a, uint32_t b) { return freq[a] < freq[b]; });
+        const size_t n = syms.size();
+        if (maxLen < 32 && n > (size_t(1) << maxLen))
+            throw std::runtime_error("buildCodeLengths: alphabet too large for maxLen");
+
+        std::vector<uint64_t> weights(n);
+        for (size_t i = 0; i < n; ++i)
+            weights[i] = freq[syms[i]];
+        std::vector<uint64_t> depth(weights);
+        minimumRedundancyLengths(depth);
+
+        if (depth[0] > maxLen && limit == LengthLimit::PackageMerge)
         {
-            auto [u, d] = st.back();
-            st.pop_back();
-            if (nodes[u].left == -1 && nodes[u].right == -1)
-            {
-                codeLen[nodes[u].sym] = (uint8_t)d;
-            }
-            else
-            {
-                if (nodes[u].left != -1)
-                    st.push_back({nodes[u].left, d + 1});
-                if (nodes[u].right != -1)
-                    st.push_back({nodes[u].right, d + 1});
-            }
+            std::vector<uint8_t> lengths;
+            packageMergeLengths(weights, maxLen, lengths);
+            for (size_t i = 0; i < n; ++i)
+                codeLen[syms[i]] = lengths[i];
+            return codeLen;
         }
+        for (size_t i = 0; i < n; ++i)
+            codeLen[syms[i]] = (uint8_t)std::min<uint64_t>(depth[i], 255);
+        // Si el árbol ya entra en maxLen es óptimo tal cual (depth[0] es el más profundo)
+        if (depth[0] <= maxLen)
+            return codeLen;
 
         // limita a maxLen (estrategia pragmática)
         for (auto &L : codeLen)
@@ -124,36 +197,28 @@ namespace huff
         };
         if (kraftOverflow())
         {
-            struct Item
-            {
-                uint8_t L;
-                uint32_t f;
-                uint32_t s;
-            };
-            std::vector<Item> items;
-            for (uint32_t s = 0; s < N; ++s)
-                if (codeLen[s])
-                    items.push_back({codeLen[s], freq[s], s});
-            std::sort(items.begin(), items.end(), [](const Item &a, const Item &b)
-                      {
-            if (a.L != b.L) return a.L > b.L;   // más largos primero
-            if (a.f != b.f) return a.f < b.f;   // menos frecuentes primero
-            return a.s < b.s; });
-            while (kraftOverflow())
+            // Recortar a maxLen deja la suma de Kraft > 1: se alargan códigos (el más
+            // largo que aún no llegó a maxLen, y entre iguales el menos frecuente)
+            // hasta que vuelva a caber. Cada paso libera 2^(maxLen - L - 1).
+            long long sum = 0;
+            for (auto L : codeLen)
+                if (L)
+                    sum += (1LL << (maxLen - L));
+            const long long kraftLimit = 1LL << maxLen;
+            while (sum > kraftLimit)
             {
-                for (auto &it : items)
+                int best = -1;
+                for (uint32_t s = 0; s < N; ++s)
                 {
-                    if (it.L > 1)
-                    {
-                        it.L--;
-                        if (!kraftOverflow())
-                            break;
-                    }
+                    uint8_t L = codeLen[s];
+                    if (L == 0 || L >= maxLen)
+                        continue;
+                    if (best < 0 || L > codeLen[best] || (L == codeLen[best] && freq[s] < freq[best]))
+                        best = (int)s;
                 }
+                sum -= 1LL << (maxLen - codeLen[best] - 1);
+                codeLen[best]++;
             }
-            std::fill(codeLen.begin(), codeLen.end(), 0);
-            for (auto &it : items)
-                codeLen[it.s] = it.L;
         }
 
         return codeLen;
@@ -190,9 +255,10 @@ namespace huff
 
     // ---------- CanonicalHuffman ----------
 
-    void CanonicalHuffman::build(const std::vector<uint32_t> &frequencies, uint8_t maxCodeLen)
+    void CanonicalHuffman::build(const std::vector<uint32_t> &frequencies, uint8_t maxCodeLen,
+                                 LengthLimit limit)
     {
-        codeLen_ = buildCodeLengths(frequencies, maxCodeLen);
+        codeLen_ = buildCodeLengths(frequencies, maxCodeLen, limit);
         uint8_t m = 0;
         for (auto L : codeLen_)
             m = std::max<uint8_t>(m, L);
@@ -212,21 +278,63 @@ namespace huff
 
     void CanonicalHuffman::buildDecoder()
     {
-        // Prepara tablas de códigos revertidos (para LSB-first) y buckets por longitud.
-        uint8_t maxLen = 0;
+        // Tabla raíz de rootBits_ bits + una subtabla por cada prefijo raíz de los
+        // códigos más largos. Un código de longitud L ocupa 2^(bits - L) entradas.
+        maxLen_ = 0;
         for (auto L : codeLen_)
-            if (L)
-                maxLen = std::max<uint8_t>(maxLen, L);
+            maxLen_ = std::max<int>(maxLen_, L);
+        if (maxLen_ > MAX_CODE_LEN)
+            throw std::runtime_error("buildDecoder: code length too long");
+        rootBits_ = std::min(ROOT_BITS, std::max(maxLen_, 1));
 
-        revCode_.assign(codes_.size(), 0);
+        const uint32_t rootSize = 1u << rootBits_;
+        const uint32_t rootMask = rootSize - 1;
+        table_.assign(rootSize, 0);
+
+        // Bits extra que necesita la subtabla de cada prefijo raíz
+        std::vector<uint8_t> subBits(rootSize, 0);
         for (size_t s = 0; s < codes_.size(); ++s)
-            if (codes_[s].len)
-                revCode_[s] = bitrev(codes_[s].code, codes_[s].len);
+        {
+            int L = codes_[s].len;
+            if (L > rootBits_)
+            {
+                uint32_t rev = bitrev(codes_[s].code, L);
+                uint8_t &b = subBits[rev & rootMask];
+                b = std::max<uint8_t>(b, (uint8_t)(L - rootBits_));
+            }
+        }
+        for (uint32_t r = 0; r < rootSize; ++r)
+        {
+            if (subBits[r])
+            {
+                table_[r] = ((uint32_t)table_.size() << 8) | LINK | subBits[r];
+                table_.resize(table_.size() + (size_t(1) << subBits[r]), 0);
+            }
+        }
 
-        byLenSyms_.assign(maxLen + 1, {});
+        revCodes_.assign(codes_.size(), 0);
         for (size_t s = 0; s < codes_.size(); ++s)
-            if (codes_[s].len)
-                byLenSyms_[codes_[s].len].push_back((uint32_t)s);
+        {
+            int L = codes_[s].len;
+            if (!L)
+                continue;
+            uint32_t rev = bitrev(codes_[s].code, L);
+            revCodes_[s] = rev;
+            uint32_t leaf = ((uint32_t)s << 8) | (uint32_t)L;
+            if (L <= rootBits_)
+            {
+                for (uint32_t i = rev; i < rootSize; i += 1u << L)
+                    table_[i] = leaf;
+            }
+            else
+            {
+                uint32_t link = table_[rev & rootMask];
+                uint32_t base = link >> 8;
+                uint32_t size = 1u << (link & 0x7F);
+                for (uint32_t i = rev >> rootBits_; i < size; i += 1u << (L - rootBits_))
+                    table_[base + i] = leaf;
+            }
+        }
     }
 
     void CanonicalHuffman::encodeSymbol(BitWriter &bw, uint32_t sym) const
@@ -237,23 +345,14 @@ namespace huff
         if (c.len == 0)
             throw std::runtime_error("encodeSymbol: zero-length code");
         // Emitimos en LSB-first -> escribir el código canónico **revertido**
-        bw.writeBits(bitrev(c.code, c.len), c.len);
+        bw.writeBits(revCodes_[sym], c.len);
     }
 
     uint32_t CanonicalHuffman::decodeSymbol(BitReader &br) const
     {
-        uint32_t code = 0;
-        for (uint32_t L = 1; L < byLenSyms_.size(); ++L)
-        {
-            code |= (br.readBits(1) << (L - 1)); // LSB-first
-            const auto &bucket = byLenSyms_[L];
-            for (uint32_t s : bucket)
-            {
-                if (revCode_[s] == code)
-                    return s; // match exacto
-            }
-        }
-        throw std::runtime_error("decodeSymbol: invalid code");
+        // Un peek de maxLen_ bits resuelve el símbolo con una o dos lecturas de tabla
+        br.refill();
+        return decodeLoaded(br);
     }
 
     // ---------- Stream simple (cabecera + bitstream) ----------
@@ -274,99 +373,717 @@ namespace huff
         out.push_back((uint8_t)((v >> 16) & 0xFF));
         out.push_back((uint8_t)((v >> 24) & 0xFF));
     }
+    static void putU32(std::vector<uint8_t> &out, uint32_t v)
+    {
+        out.push_back((uint8_t)(v & 0xFF));
+        out.push_back((uint8_t)((v >> 8) & 0xFF));
+        out.push_back((uint8_t)((v >> 16) & 0xFF));
+        out.push_back((uint8_t)((v >> 24) & 0xFF));
+    }
     static uint16_t readU16(const uint8_t *p) { return (uint16_t)p[0] | ((uint16_t)p[1] << 8); }
     static uint32_t readU32(const uint8_t *p) { return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24); }
 
+    // Frecuencias de symbols; lanza si algún símbolo no entra en el alfabeto
+    template <typename Sym>
+    static std::vector<uint32_t> countFrequencies(const Sym *symbols, size_t count,
+                                                  uint32_t alphabetSize)
+    {
+        std::vector<uint32_t> freq(alphabetSize, 0);
+        if (!histogram::count(symbols, count, alphabetSize, freq.data()))
+            throw std::runtime_error("encodeHuffmanStream: symbol out of range");
+        return freq;
+    }
+
+    // Cabecera común: [u16 alphabet][code_lens][u32 num_symbols]
+    static void writeTableHeader(BitWriter &bw, const CanonicalHuffman &H,
+                                 uint32_t alphabetSize, size_t numSymbols)
+    {
+        const auto &lens = H.codeLengths();
+        writeU16(bw, (uint16_t)alphabetSize);
+        bw.flushZeroPadding();
+        auto &out = bw.data();
+        out.insert(out.end(), lens.begin(), lens.end());
+        writeU32(bw, (uint32_t)numSymbols);
+    }
+
+    template <typename Sym>
+    std::vector<uint8_t> encodeHuffmanStream(const Sym *symbols, size_t count,
+                                             uint32_t alphabetSize, uint8_t maxCodeLen)
+    {
+        // 1) Frecuencias
+        auto freq = countFrequencies(symbols, count, alphabetSize);
+
+        // 2) Construir huffman
+        CanonicalHuffman H;
+        H.build(freq, maxCodeLen);
+
+        // 3) Cabecera
+        BitWriter bw;
+        bw.reserve(6 + alphabetSize + count);
+        writeTableHeader(bw, H, alphabetSize, count);
+
+        // 4) Payload
+        for (size_t i = 0; i < count; ++i)
+            H.encodeSymbol(bw, symbols[i]);
+        bw.flushZeroPadding();
+        return bw.data();
+    }
+
     std::vector<uint8_t> encodeHuffmanStream(const std::vector<uint32_t> &symbols,
                                              uint32_t alphabetSize,
                                              uint8_t maxCodeLen)
     {
+        return encodeHuffmanStream(symbols.data(), symbols.size(), alphabetSize, maxCodeLen);
+    }
 
-        // 1) Frecuencias
-        std::vector<uint32_t> freq(alphabetSize, 0);
-        bool error_found = false;
+    // [u32 tamaño s0][u32 tamaño s1][u32 tamaño s2][s0][s1][s2][s3], con el símbolo i
+    // en el bitstream i % 4. Con sync, agrega el bit de cada bitstream en cada múltiplo
+    // de syncInterval (sin contar el 0).
+    template <typename Sym>
+    static void encodeLanes(const CanonicalHuffman &H, const Sym *symbols, size_t n,
+                            std::vector<uint8_t> &out, size_t syncInterval = 0,
+                            std::vector<uint64_t> *sync = nullptr)
+    {
+        BitWriter lanes[4];
+        for (auto &lane : lanes)
+            lane.reserve(n / 4 + 8);
+        auto mark = [&](size_t i)
+        {
+            if (sync && i > 0 && i % syncInterval == 0)
+                for (auto &lane : lanes)
+                    sync->push_back(lane.bitCount());
+        };
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            mark(i);
+            H.encodeSymbol(lanes[0], symbols[i]);
+            H.encodeSymbol(lanes[1], symbols[i + 1]);
+            H.encodeSymbol(lanes[2], symbols[i + 2]);
+            H.encodeSymbol(lanes[3], symbols[i + 3]);
+        }
+        if (i < n)
+            mark(i);
+        for (; i < n; ++i)
+            H.encodeSymbol(lanes[i % 4], symbols[i]);
+        for (auto &lane : lanes)
+            lane.flushZeroPadding();
+
+        for (int k = 0; k < 3; ++k)
+            putU32(out, (uint32_t)lanes[k].data().size());
+        for (auto &lane : lanes)
+            out.insert(out.end(), lane.data().begin(), lane.data().end());
+    }
+
+    template <typename Sym>
+    std::vector<uint8_t> encodeHuffmanStreamX4(const Sym *symbols, size_t count,
+                                               uint32_t alphabetSize, uint8_t maxCodeLen)
+    {
+        if (count < X4_MIN_SYMBOLS)
+            return encodeHuffmanStream(symbols, count, alphabetSize, maxCodeLen);
 
-#pragma omp parallel
+        auto freq = countFrequencies(symbols, count, alphabetSize);
+        CanonicalHuffman H;
+        H.build(freq, maxCodeLen);
+
+        BitWriter bw;
+        writeU16(bw, 0);
+        bw.data().push_back(STREAM_X4);
+        writeTableHeader(bw, H, alphabetSize, count);
+        if (count < SYNC_MIN_SYMBOLS)
         {
-            std::vector<uint32_t> freq_local(alphabetSize, 0);
+            encodeLanes(H, symbols, count, bw.data());
+            return bw.data();
+        }
+
+        // Con índice: los bitstreams se arman aparte porque el índice va antes
+        std::vector<uint64_t> sync;
+        std::vector<uint8_t> lanes;
+        encodeLanes(H, symbols, count, lanes, SYNC_INTERVAL, &sync);
+        auto &out = bw.data();
+        // Los offsets van en u32: con bitstreams de más de 512 MiB queda el X4 sin índice
+        if (sync.empty() || sync.back() <= UINT32_MAX)
+        {
+            out[2] = STREAM_X4_SYNC;
+            putU32(out, (uint32_t)SYNC_INTERVAL);
+            for (uint64_t bit : sync)
+                putU32(out, (uint32_t)bit);
+        }
+        out.insert(out.end(), lanes.begin(), lanes.end());
+        return out;
+    }
+
+    std::vector<uint8_t> encodeHuffmanStreamX4(const std::vector<uint32_t> &symbols,
+                                               uint32_t alphabetSize,
+                                               uint8_t maxCodeLen)
+    {
+        return encodeHuffmanStreamX4(symbols.data(), symbols.size(), alphabetSize, maxCodeLen);
+    }
+
+    // ---------- Longitudes de código compactas (como DEFLATE) ----------
+    // Símbolos: 0..15 una longitud, 16 = repetir la anterior 3-6 veces (2 bits extra),
+    // 17 = 3-10 ceros (3 bits extra), 18 = 11-138 ceros (7 bits extra). Esos 19 símbolos
+    // van con su propio Huffman, cuyas longitudes (<= 7) ocupan 3 bits cada una.
 
-#pragma omp for nowait
-            for (size_t i = 0; i < symbols.size(); i++)
+    static constexpr uint32_t CL_ALPHABET = 19;
+    static constexpr uint8_t CL_MAX_LEN = 7;
+    static constexpr int CL_EXTRA_BITS[3] = {2, 3, 7};
+
+    static void writeCompactLengths(BitWriter &bw, const std::vector<uint8_t> &lens)
+    {
+        struct Op
+        {
+            uint32_t sym;
+            uint32_t extra;
+        };
+        std::vector<Op> ops;
+        const size_t N = lens.size();
+        for (size_t i = 0; i < N;)
+        {
+            const uint8_t L = lens[i];
+            size_t run = 1;
+            while (i + run < N && lens[i + run] == L)
+                ++run;
+            i += run;
+
+            if (L == 0)
             {
-                uint32_t s = symbols[i];
-                if (s >= alphabetSize)
-                {
-#pragma omp atomic write
-                    error_found = true;
-                }
-                else
+                for (; run >= 11; run -= std::min<size_t>(run, 138))
+                    ops.push_back({18, (uint32_t)std::min<size_t>(run, 138) - 11});
+                if (run >= 3)
                 {
-                    freq_local[s]++;
+                    ops.push_back({17, (uint32_t)run - 3});
+                    run = 0;
                 }
             }
+            else
+            {
+                ops.push_back({L, 0});
+                for (--run; run >= 3; run -= std::min<size_t>(run, 6))
+                    ops.push_back({16, (uint32_t)std::min<size_t>(run, 6) - 3});
+            }
+            for (; run > 0; --run)
+                ops.push_back({L, 0});
+        }
+
+        std::vector<uint32_t> freq(CL_ALPHABET, 0);
+        for (const auto &op : ops)
+            freq[op.sym]++;
+        CanonicalHuffman clH;
+        clH.build(freq, CL_MAX_LEN);
+        for (auto L : clH.codeLengths())
+            bw.writeBits(L, 3);
+        for (const auto &op : ops)
+        {
+            clH.encodeSymbol(bw, op.sym);
+            if (op.sym >= 16)
+                bw.writeBits(op.extra, CL_EXTRA_BITS[op.sym - 16]);
+        }
+    }
 
-#pragma omp critical
+    static std::vector<uint8_t> readCompactLengths(BitReader &br, uint32_t alphabetSize)
+    {
+        std::vector<uint8_t> clLens(CL_ALPHABET);
+        for (auto &L : clLens)
+            L = (uint8_t)br.readBits(3);
+        CanonicalHuffman clH;
+        clH.loadFromCodeLengths(clLens);
+
+        std::vector<uint8_t> lens;
+        lens.reserve(alphabetSize);
+        while (lens.size() < alphabetSize)
+        {
+            uint32_t sym = clH.decodeSymbol(br);
+            if (sym < 16)
             {
-                for (uint32_t j = 0; j < alphabetSize; j++)
-                {
-                    freq[j] += freq_local[j];
-                }
+                lens.push_back((uint8_t)sym);
+                continue;
             }
+            if (sym == 16 && lens.empty())
+                throw std::runtime_error("decodeHuffmanStream: bad code lengths");
+            const uint8_t value = (sym == 16) ? lens.back() : 0;
+            const size_t base = (sym == 18) ? 11 : 3;
+            const size_t run = base + br.readBits(CL_EXTRA_BITS[sym - 16]);
+            if (lens.size() + run > alphabetSize)
+                throw std::runtime_error("decodeHuffmanStream: bad code lengths");
+            lens.insert(lens.end(), run, value);
         }
+        if (br.overrun())
+            throw std::runtime_error("decodeHuffmanStream: truncated code lengths");
+        return lens;
+    }
 
-        // Lanzar excepción fuera de la región paralela
-        if (error_found)
+    // ---------- Stream por bloques ----------
+
+    // Bits del payload con esas longitudes; UINT64_MAX si algún símbolo usado no tiene código
+    static uint64_t payloadBits(const std::vector<uint32_t> &freq, const std::vector<uint8_t> &lens)
+    {
+        uint64_t bits = 0;
+        for (size_t s = 0; s < freq.size(); ++s)
+        {
+            if (!freq[s])
+                continue;
+            if (!lens[s])
+                return std::numeric_limits<uint64_t>::max();
+            bits += (uint64_t)freq[s] * lens[s];
+        }
+        return bits;
+    }
+
+    template <typename Sym>
+    std::vector<uint8_t> encodeHuffmanStreamBlocked(const Sym *symbols, size_t count,
+                                                    uint32_t alphabetSize, uint8_t maxCodeLen)
+    {
+        if (count <= BLOCK_SYMBOLS)
+            return encodeHuffmanStreamX4(symbols, count, alphabetSize, maxCodeLen);
+        if (maxCodeLen > 15)
+            throw std::runtime_error("encodeHuffmanStreamBlocked: maxCodeLen > 15");
+
+        struct Block
+        {
+            std::vector<uint32_t> freq;
+            CanonicalHuffman H;
+            std::vector<uint8_t> table;    // longitudes compactas de H
+            std::vector<uint8_t> payload;
+            size_t tableBlock = 0;         // bloque cuya tabla se usa
+        };
+        const size_t numBlocks = (count + BLOCK_SYMBOLS - 1) / BLOCK_SYMBOLS;
+        std::vector<Block> blocks(numBlocks);
+        bool error_found = false;
+
+        // 1) En paralelo: frecuencias y tabla propia de cada bloque
+#pragma omp parallel for schedule(dynamic)
+        for (size_t b = 0; b < numBlocks; ++b)
         {
+            Block &B = blocks[b];
+            const size_t begin = b * BLOCK_SYMBOLS;
+            const size_t end = std::min(count, begin + BLOCK_SYMBOLS);
+            B.freq.assign(alphabetSize, 0);
+            if (!histogram::count(symbols + begin, end - begin, alphabetSize, B.freq.data()))
+            {
+#pragma omp atomic write
+                error_found = true;
+                continue;
+            }
+            B.H.build(B.freq, maxCodeLen);
+            BitWriter bw;
+            writeCompactLengths(bw, B.H.codeLengths());
+            bw.flushZeroPadding();
+            B.table = std::move(bw.data());
+        }
+        if (error_found)
             throw std::runtime_error("encodeHuffmanStream: symbol out of range");
+
+        // 2) En orden: se reutiliza la tabla vigente mientras cueste menos que mandar
+        // la propia del bloque
+        size_t current = 0;
+        for (size_t b = 1; b < numBlocks; ++b)
+        {
+            const uint64_t reuse = payloadBits(blocks[b].freq, blocks[current].H.codeLengths());
+            const uint64_t fresh = payloadBits(blocks[b].freq, blocks[b].H.codeLengths()) +
+                                   8 * (uint64_t)blocks[b].table.size();
+            if (fresh < reuse)
+                current = b;
+            blocks[b].tableBlock = current;
         }
 
-        // 2) Construir huffman
-        CanonicalHuffman H;
-        H.build(freq, maxCodeLen);
-        const auto &lens = H.codeLengths();
+        // 3) En paralelo: payload de cada bloque con la tabla elegida
+#pragma omp parallel for schedule(dynamic)
+        for (size_t b = 0; b < numBlocks; ++b)
+        {
+            const size_t begin = b * BLOCK_SYMBOLS;
+            const size_t end = std::min(count, begin + BLOCK_SYMBOLS);
+            encodeLanes(blocks[blocks[b].tableBlock].H, symbols + begin, end - begin,
+                        blocks[b].payload);
+        }
 
-        // 3) Cabecera
+        // 4) Concatenar
         BitWriter bw;
-        writeU16(bw, (uint16_t)alphabetSize);
-        bw.flushZeroPadding();
-        auto &out = const_cast<std::vector<uint8_t> &>(bw.data());
-        out.insert(out.end(), lens.begin(), lens.end());
-        writeU32(bw, (uint32_t)symbols.size());
+        writeU16(bw, 0);
+        auto &out = bw.data();
+        out.push_back(STREAM_BLOCKED);
+        out.push_back((uint8_t)(alphabetSize & 0xFF));
+        out.push_back((uint8_t)((alphabetSize >> 8) & 0xFF));
+        putU32(out, (uint32_t)count);
+        putU32(out, (uint32_t)BLOCK_SYMBOLS);
+        for (size_t b = 0; b < numBlocks; ++b)
+        {
+            const Block &B = blocks[b];
+            if (B.tableBlock == b)
+            {
+                out.push_back(BLOCK_NEW_TABLE);
+                out.insert(out.end(), B.table.begin(), B.table.end());
+            }
+            else
+            {
+                out.push_back(BLOCK_REUSE_TABLE);
+            }
+            putU32(out, (uint32_t)B.payload.size());
+            out.insert(out.end(), B.payload.begin(), B.payload.end());
+        }
+        return out;
+    }
 
-        // 4) Payload
-        for (auto s : symbols)
-            H.encodeSymbol(bw, s);
-        bw.flushZeroPadding();
-        return bw.data();
+    std::vector<uint8_t> encodeHuffmanStreamBlocked(const std::vector<uint32_t> &symbols,
+                                                    uint32_t alphabetSize,
+                                                    uint8_t maxCodeLen)
+    {
+        return encodeHuffmanStreamBlocked(symbols.data(), symbols.size(), alphabetSize, maxCodeLen);
     }
 
-    std::vector<uint32_t> decodeHuffmanStream(const uint8_t *data, size_t size)
+    // Lee [u16 alphabet][code_lens][u32 num_symbols] desde off
+    static uint32_t readTableHeader(const uint8_t *data, size_t size, size_t &off,
+                                    CanonicalHuffman &H)
     {
-        if (size < 2)
+        if (size < off + 2)
             throw std::runtime_error("decodeHuffmanStream: truncated header");
-        uint16_t alphabetSize = readU16(data);
-        size_t off = 2;
+        uint16_t alphabetSize = readU16(data + off);
+        off += 2;
         if (size < off + alphabetSize)
             throw std::runtime_error("decodeHuffmanStream: truncated code lengths");
-        std::vector<uint8_t> lens(alphabetSize);
-        std::copy(data + off, data + off + alphabetSize, lens.begin());
+        std::vector<uint8_t> lens(data + off, data + off + alphabetSize);
         off += alphabetSize;
         if (size < off + 4)
             throw std::runtime_error("decodeHuffmanStream: truncated symbol count");
         uint32_t nsyms = readU32(data + off);
         off += 4;
-        if (off > size)
-            throw std::runtime_error("decodeHuffmanStream: bad offsets");
+        H.loadFromCodeLengths(lens);
+        return nsyms;
+    }
+
+    // Ubica los 4 bitstreams de [u32 tamaño s0][u32 tamaño s1][u32 tamaño s2][s0]..[s3]
+    static void splitLanes(const uint8_t *data, size_t size, size_t nsyms,
+                           const uint8_t *lane[4], size_t laneSize[4])
+    {
+        if (size < 12)
+            throw std::runtime_error("decodeHuffmanStream: truncated jump table");
+        const size_t payload = size - 12;
+        size_t total = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            laneSize[k] = readU32(data + 4 * k);
+            total += laneSize[k];
+        }
+        if (total > payload)
+            throw std::runtime_error("decodeHuffmanStream: bad jump table");
+        laneSize[3] = payload - total;
+        if ((uint64_t)nsyms > (uint64_t)payload * 8)
+            throw std::runtime_error("decodeHuffmanStream: truncated payload");
+
+        lane[0] = data + 12;
+        for (int k = 1; k < 4; ++k)
+            lane[k] = lane[k - 1] + laneSize[k - 1];
+    }
+
+    // Lector de un bitstream que arranca en el bit startBit
+    static BitReader laneReader(const uint8_t *lane, size_t laneSize, uint64_t startBit)
+    {
+        if (startBit > (uint64_t)laneSize * 8)
+            throw std::runtime_error("decodeHuffmanStream: bad sync point");
+        const size_t skip = (size_t)(startBit >> 3);
+        BitReader br(lane + skip, laneSize - skip);
+        if (startBit & 7)
+            br.readBits((int)(startBit & 7));
+        return br;
+    }
+
+    // Decodifica nsyms símbolos en o (el primero sale del bitstream 0) con cada bitstream
+    // arrancando en start[k]; deja en end[k] el bit donde terminó cada uno
+    template <typename Sym>
+    static void decodeLaneRange(const CanonicalHuffman &H, const uint8_t *const lane[4],
+                                const size_t laneSize[4], const uint64_t start[4],
+                                Sym *o, size_t nsyms, uint64_t end[4])
+    {
+        BitReader br0 = laneReader(lane[0], laneSize[0], start[0]);
+        BitReader br1 = laneReader(lane[1], laneSize[1], start[1]);
+        BitReader br2 = laneReader(lane[2], laneSize[2], start[2]);
+        BitReader br3 = laneReader(lane[3], laneSize[3], start[3]);
+        BitReader *lanes[4] = {&br0, &br1, &br2, &br3};
+
+        // Cuatro cadenas independientes por iteración; cada recarga alcanza para
+        // perRefill símbolos de cada bitstream
+        const size_t perRefill = 56 / std::max(1, H.maxCodeLength());
+        const size_t step = 4 * perRefill;
+        size_t i = 0;
+        for (; i + step <= nsyms; i += step)
+        {
+            br0.refill();
+            br1.refill();
+            br2.refill();
+            br3.refill();
+            for (size_t k = 0; k < step; k += 4)
+            {
+                o[i + k] = (Sym)H.decodeLoaded(br0);
+                o[i + k + 1] = (Sym)H.decodeLoaded(br1);
+                o[i + k + 2] = (Sym)H.decodeLoaded(br2);
+                o[i + k + 3] = (Sym)H.decodeLoaded(br3);
+            }
+        }
+        for (; i < nsyms; ++i)
+            o[i] = (Sym)H.decodeSymbol(*lanes[i % 4]);
+        for (int k = 0; k < 4; ++k)
+        {
+            if (lanes[k]->overrun())
+                throw std::runtime_error("decodeHuffmanStream: truncated payload");
+            end[k] = (start[k] & ~uint64_t(7)) + lanes[k]->consumedBits();
+        }
+    }
+
+    // Inverso de encodeLanes: decodifica nsyms símbolos de size bytes en o
+    template <typename Sym>
+    static void decodeLanes(const CanonicalHuffman &H, const uint8_t *data, size_t size,
+                            Sym *o, size_t nsyms)
+    {
+        const uint8_t *lane[4];
+        size_t laneSize[4];
+        splitLanes(data, size, nsyms, lane, laneSize);
+        const uint64_t start[4] = {0, 0, 0, 0};
+        uint64_t end[4];
+        decodeLaneRange(H, lane, laneSize, start, o, nsyms, end);
+    }
+
+    // Antes de escribir en out: el alfabeto tiene que caber en Sym y los símbolos en out
+    template <typename Sym>
+    static void checkOutput(uint32_t alphabetSize, size_t nsyms, size_t capacity)
+    {
+        if ((uint64_t)alphabetSize > (uint64_t)std::numeric_limits<Sym>::max() + 1)
+            throw std::runtime_error("decodeHuffmanStream: alphabet too large for symbol type");
+        if (nsyms > capacity)
+            throw std::runtime_error("decodeHuffmanStream: output buffer too small");
+    }
 
+    template <typename Sym>
+    static size_t decodeSimple(const uint8_t *data, size_t size, Sym *out, size_t capacity)
+    {
+        size_t off = 0;
         CanonicalHuffman H;
-        H.loadFromCodeLengths(lens);
+        uint32_t nsyms = readTableHeader(data, size, off, H);
+
+        // Cada símbolo ocupa al menos 1 bit
+        if ((uint64_t)nsyms > (uint64_t)(size - off) * 8)
+            throw std::runtime_error("decodeHuffmanStream: truncated payload");
+        checkOutput<Sym>((uint32_t)H.codeLengths().size(), nsyms, capacity);
 
         BitReader br(data + off, size - off);
-        std::vector<uint32_t> out;
-        out.reserve(nsyms);
-        for (uint32_t i = 0; i < nsyms; ++i)
-            out.push_back(H.decodeSymbol(br));
+        const size_t perRefill = 56 / std::max(1, H.maxCodeLength());
+        size_t i = 0;
+        for (; i + perRefill <= nsyms; i += perRefill)
+        {
+            br.refill();
+            for (size_t k = 0; k < perRefill; ++k)
+                out[i + k] = (Sym)H.decodeLoaded(br);
+        }
+        for (; i < nsyms; ++i)
+            out[i] = (Sym)H.decodeSymbol(br);
+        if (br.overrun())
+            throw std::runtime_error("decodeHuffmanStream: truncated payload");
+        return nsyms;
+    }
+
+    template <typename Sym>
+    static size_t decodeInterleaved(const uint8_t *data, size_t size, size_t off,
+                                    Sym *out, size_t capacity)
+    {
+        CanonicalHuffman H;
+        uint32_t nsyms = readTableHeader(data, size, off, H);
+        if ((uint64_t)nsyms > (uint64_t)(size - off) * 8)
+            throw std::runtime_error("decodeHuffmanStream: truncated payload");
+        checkOutput<Sym>((uint32_t)H.codeLengths().size(), nsyms, capacity);
+        decodeLanes(H, data + off, size - off, out, nsyms);
+        return nsyms;
+    }
+
+    // X4 con índice: cada tramo de syncInterval símbolos se decodifica en su propio hilo
+    // desde los bits del índice; al terminar, cada bitstream tiene que quedar justo en el
+    // punto siguiente
+    template <typename Sym>
+    static size_t decodeInterleavedSync(const uint8_t *data, size_t size, size_t off,
+                                        Sym *out, size_t capacity)
+    {
+        CanonicalHuffman H;
+        const uint32_t nsyms = readTableHeader(data, size, off, H);
+        if (size < off + 4)
+            throw std::runtime_error("decodeHuffmanStream: truncated sync index");
+        const uint32_t interval = readU32(data + off);
+        off += 4;
+        if (interval == 0 || interval % 4 != 0)
+            throw std::runtime_error("decodeHuffmanStream: bad sync interval");
+        const size_t segments = ((size_t)nsyms + interval - 1) / interval;
+        const size_t points = segments ? segments - 1 : 0;
+        if ((size - off) / 16 < points)
+            throw std::runtime_error("decodeHuffmanStream: truncated sync index");
+        std::vector<uint64_t> start(4 * segments, 0);
+        for (size_t k = 0; k < 4 * points; ++k)
+            start[4 + k] = readU32(data + off + 4 * k);
+        off += 16 * points;
+        if ((uint64_t)nsyms > (uint64_t)(size - off) * 8)
+            throw std::runtime_error("decodeHuffmanStream: truncated payload");
+        checkOutput<Sym>((uint32_t)H.codeLengths().size(), nsyms, capacity);
+
+        const uint8_t *lane[4];
+        size_t laneSize[4];
+        splitLanes(data + off, size - off, nsyms, lane, laneSize);
+
+        bool error_found = false;
+#pragma omp parallel for schedule(dynamic)
+        for (size_t s = 0; s < segments; ++s)
+        {
+            const size_t begin = s * interval;
+            const size_t n = std::min<size_t>(interval, nsyms - begin);
+            try
+            {
+                uint64_t end[4];
+                decodeLaneRange(H, lane, laneSize, &start[4 * s], out + begin, n, end);
+                if (s + 1 < segments)
+                    for (int k = 0; k < 4; ++k)
+                        if (end[k] != start[4 * (s + 1) + k])
+                            throw std::runtime_error("decodeHuffmanStream: sync point mismatch");
+            }
+            catch (const std::exception &)
+            {
+#pragma omp atomic write
+                error_found = true;
+            }
+        }
+        if (error_found)
+            throw std::runtime_error("decodeHuffmanStream: corrupt sync segment");
+        return nsyms;
+    }
+
+    template <typename Sym>
+    static size_t decodeBlocked(const uint8_t *data, size_t size, size_t off,
+                                Sym *out, size_t capacity)
+    {
+        if (size < off + 10)
+            throw std::runtime_error("decodeHuffmanStream: truncated header");
+        const uint32_t alphabetSize = readU16(data + off);
+        const uint32_t nsyms = readU32(data + off + 2);
+        const uint32_t blockSymbols = readU32(data + off + 6);
+        off += 10;
+        if (blockSymbols == 0)
+            throw std::runtime_error("decodeHuffmanStream: bad block size");
+        if ((uint64_t)nsyms > (uint64_t)(size - off) * 8)
+            throw std::runtime_error("decodeHuffmanStream: truncated payload");
+        checkOutput<Sym>(alphabetSize, nsyms, capacity);
+
+        // Las tablas se leen en orden (reutilizar depende del bloque anterior); los
+        // payloads quedan ubicados para decodificarlos en paralelo
+        const size_t numBlocks = ((size_t)nsyms + blockSymbols - 1) / blockSymbols;
+        std::vector<CanonicalHuffman> tables;
+        std::vector<size_t> tableOf(numBlocks), payloadOff(numBlocks), payloadSize(numBlocks);
+        for (size_t b = 0; b < numBlocks; ++b)
+        {
+            if (off >= size)
+                throw std::runtime_error("decodeHuffmanStream: truncated block");
+            const uint8_t flag = data[off++];
+            if (flag == BLOCK_NEW_TABLE)
+            {
+                BitReader br(data + off, size - off);
+                auto lens = readCompactLengths(br, alphabetSize);
+                off += br.bytesConsumed();
+                tables.emplace_back();
+                tables.back().loadFromCodeLengths(lens);
+            }
+            else if (flag != BLOCK_REUSE_TABLE || tables.empty())
+            {
+                throw std::runtime_error("decodeHuffmanStream: bad block flag");
+            }
+            tableOf[b] = tables.size() - 1;
+
+            if (size < off + 4)
+                throw std::runtime_error("decodeHuffmanStream: truncated block");
+            payloadSize[b] = readU32(data + off);
+            off += 4;
+            if (payloadSize[b] > size - off)
+                throw std::runtime_error("decodeHuffmanStream: truncated block");
+            payloadOff[b] = off;
+            off += payloadSize[b];
+        }
+
+        bool error_found = false;
+#pragma omp parallel for schedule(dynamic)
+        for (size_t b = 0; b < numBlocks; ++b)
+        {
+            const size_t begin = b * blockSymbols;
+            const size_t end = std::min<size_t>(nsyms, begin + blockSymbols);
+            try
+            {
+                decodeLanes(tables[tableOf[b]], data + payloadOff[b], payloadSize[b],
+                            out + begin, end - begin);
+            }
+            catch (const std::exception &)
+            {
+#pragma omp atomic write
+                error_found = true;
+            }
+        }
+        if (error_found)
+            throw std::runtime_error("decodeHuffmanStream: corrupt block");
+        return nsyms;
+    }
+
+    // Variante según el escape: alphabet_size 0 seguido del tipo (un stream simple con
+    // alfabeto vacío no puede tener símbolos, así que no se confunde). 0 = stream simple.
+    static uint8_t streamVariant(const uint8_t *data, size_t size)
+    {
+        if (size < 2)
+            throw std::runtime_error("decodeHuffmanStream: truncated header");
+        if (readU16(data) == 0 && size >= 3 &&
+            (data[2] == STREAM_X4 || data[2] == STREAM_BLOCKED || data[2] == STREAM_X4_SYNC))
+            return data[2];
+        return 0;
+    }
+
+    size_t decodedSymbolCount(const uint8_t *data, size_t size)
+    {
+        const uint8_t variant = streamVariant(data, size);
+        size_t off = (variant == 0) ? 0 : 3;
+        if (size < off + 2)
+            throw std::runtime_error("decodeHuffmanStream: truncated header");
+        // En el stream por bloques la cantidad sigue al alfabeto; en los otros, a las longitudes
+        off += 2 + ((variant == STREAM_BLOCKED) ? 0 : readU16(data + off));
+        if (size < off + 4)
+            throw std::runtime_error("decodeHuffmanStream: truncated symbol count");
+        const uint32_t nsyms = readU32(data + off);
+        if ((uint64_t)nsyms > (uint64_t)(size - off - 4) * 8)
+            throw std::runtime_error("decodeHuffmanStream: truncated payload");
+        return nsyms;
+    }
+
+    template <typename Sym>
+    size_t decodeHuffmanStreamInto(const uint8_t *data, size_t size, Sym *out, size_t capacity)
+    {
+        switch (streamVariant(data, size))
+        {
+        case STREAM_X4:
+            return decodeInterleaved(data, size, 3, out, capacity);
+        case STREAM_X4_SYNC:
+            return decodeInterleavedSync(data, size, 3, out, capacity);
+        case STREAM_BLOCKED:
+            return decodeBlocked(data, size, 3, out, capacity);
+        default:
+            return decodeSimple(data, size, out, capacity);
+        }
+    }
+
+    std::vector<uint32_t> decodeHuffmanStream(const uint8_t *data, size_t size)
+    {
+        std::vector<uint32_t> out(decodedSymbolCount(data, size));
+        decodeHuffmanStreamInto(data, size, out.data(), out.size());
         return out;
     }
 
+    // Instancias de las versiones por tipo de símbolo
+#define HUFF_INSTANTIATE(Sym)                                                                      \
+    template std::vector<uint8_t> encodeHuffmanStream<Sym>(const Sym *, size_t, uint32_t, uint8_t);   \
+    template std::vector<uint8_t> encodeHuffmanStreamX4<Sym>(const Sym *, size_t, uint32_t, uint8_t); \
+    template std::vector<uint8_t> encodeHuffmanStreamBlocked<Sym>(const Sym *, size_t, uint32_t,      \
+                                                                  uint8_t);                           \
+    template size_t decodeHuffmanStreamInto<Sym>(const uint8_t *, size_t, Sym *, size_t);
+
+    HUFF_INSTANTIATE(uint8_t)
+    HUFF_INSTANTIATE(uint16_t)
+    HUFF_INSTANTIATE(uint32_t)
+#undef HUFF_INSTANTIATE
+
 } // namespace huff
@@ -2,68 +2,100 @@
 #include <cstdint>
 #include <vector>
 #include <stdexcept>
+#include <cstring>
 
 namespace huff {
 
+// Bits LSB-first sobre un acumulador de 64 bits: el writer junta bits y vuelca palabras
+// de 32 bits enteras; el reader recarga de a 7 bytes con una lectura no alineada.
 class BitWriter {
 public:
+    // nbits <= 32
     void writeBits(uint32_t bits, int nbits) {
-        while (nbits > 0) {
-            int space = 8 - bitpos_;
-            int take = (nbits < space) ? nbits : space;
-            uint32_t chunk = bits & ((1u << take) - 1u);
-            current_ |= (uint8_t)(chunk << bitpos_);
-            bitpos_ += take;
-            bits >>= take;
-            nbits -= take;
-            if (bitpos_ == 8) {
-                out_.push_back(current_);
-                current_ = 0;
-                bitpos_ = 0;
-            }
+        acc_ |= ((uint64_t)bits & ((uint64_t(1) << nbits) - 1u)) << count_;
+        count_ += nbits;
+        if (count_ >= 32) {
+            const size_t n = out_.size();
+            out_.resize(n + 4);
+            out_[n]     = (uint8_t)acc_;
+            out_[n + 1] = (uint8_t)(acc_ >> 8);
+            out_[n + 2] = (uint8_t)(acc_ >> 16);
+            out_[n + 3] = (uint8_t)(acc_ >> 24);
+            acc_ >>= 32;
+            count_ -= 32;
         }
     }
+    // Vuelca los bits pendientes completando el último byte con ceros
     void flushZeroPadding() {
-        if (bitpos_ != 0) {
-            out_.push_back(current_);
-            current_ = 0;
-            bitpos_ = 0;
+        while (count_ > 0) {
+            out_.push_back((uint8_t)acc_);
+            acc_ >>= 8;
+            count_ = (count_ > 8) ? count_ - 8 : 0;
         }
+        acc_ = 0;
     }
+    void reserve(size_t bytes) { out_.reserve(bytes); }
+    // Bits escritos hasta ahora, incluidos los que todavía no se volcaron
+    uint64_t bitCount() const { return (uint64_t)out_.size() * 8 + (uint64_t)count_; }
+    // Solo incluye lo ya volcado: llamar a flushZeroPadding antes de usarlo
     const std::vector<uint8_t>& data() const { return out_; }
     std::vector<uint8_t>& data() { return out_; }
 private:
     std::vector<uint8_t> out_;
-    uint8_t current_ = 0;
-    int bitpos_ = 0;
+    uint64_t acc_ = 0;
+    int count_ = 0;
 };
 
 class BitReader {
 public:
     BitReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
-    uint32_t readBits(int nbits) {
-        uint32_t result = 0;
-        int filled = 0;
-        while (filled < nbits) {
-            if (bitpos_ == 8) { bitpos_ = 0; ++idx_; }
-            if (idx_ >= size_) throw std::runtime_error("BitReader: out of data");
-            int avail = 8 - bitpos_;
-            int take = (nbits - filled < avail) ? (nbits - filled) : avail;
-            uint32_t bits = (data_[idx_] >> bitpos_) & ((1u << take) - 1u);
-            result |= (bits << filled);
-            bitpos_ += take;
-            filled += take;
-            if (bitpos_ == 8) { bitpos_ = 0; ++idx_; }
+
+    // Deja al menos 56 bits en el buffer. Mientras quedan 8 bytes de entrada es una
+    // lectura de 64 bits sin saltos; en la cola entran ceros (cola con padding), así
+    // peek/consume nunca revisan límites y el exceso se detecta con overrun().
+    void refill() {
+        if (pos_ + 8 <= size_) {
+            uint64_t w;
+            std::memcpy(&w, data_ + pos_, 8);
+            buf_ |= w << count_;
+            pos_ += (63 - count_) >> 3;
+            count_ |= 56;
+        } else {
+            refillTail();
         }
-        return result;
     }
-    void alignToByte() { if (bitpos_ != 0) { bitpos_ = 0; ++idx_; } }
-    size_t bytesConsumed() const { return idx_; }
+    // Próximos nbits (<= 56) ya cargados con refill
+    uint32_t peek(int nbits) const { return (uint32_t)(buf_ & ((uint64_t(1) << nbits) - 1u)); }
+    void consume(int nbits) { buf_ >>= nbits; count_ -= nbits; }
+
+    // Lectura con verificación (nbits <= 32): lanza si se pasa del final
+    uint32_t readBits(int nbits) {
+        if (count_ < nbits) refill();
+        uint32_t v = peek(nbits);
+        consume(nbits);
+        if (overrun()) throw std::runtime_error("BitReader: out of data");
+        return v;
+    }
+    // true si se consumieron más bits de los que tiene la entrada
+    bool overrun() const { return consumedBits() > (uint64_t)size_ * 8; }
+    void alignToByte() { consume(count_ & 7); }
+    size_t bytesConsumed() const { return (size_t)((consumedBits() + 7) / 8); }
+    uint64_t consumedBits() const { return (uint64_t)pos_ * 8 - (uint64_t)count_; }
 private:
+    void refillTail() {
+        while (count_ <= 56) {
+            uint64_t byte = (pos_ < size_) ? data_[pos_] : 0;
+            buf_ |= byte << count_;
+            ++pos_;   // puede pasar size_: bytes virtuales en cero
+            count_ += 8;
+        }
+    }
+
     const uint8_t* data_;
     size_t size_;
-    size_t idx_ = 0;
-    int bitpos_ = 0;
+    size_t pos_ = 0;     // bytes cargados en buf_
+    uint64_t buf_ = 0;
+    int count_ = 0;      // bits válidos en buf_
 };
 
 // ---------------- Huffman canónico ----------------
@@ -73,11 +105,18 @@ struct Code {
     uint8_t  len  = 0;
 };
 
+// Cómo se respetan las longitudes máximas cuando el árbol de Huffman queda más profundo
+enum class LengthLimit {
+    PackageMerge,   // óptimo entre los códigos de longitud <= maxCodeLen
+    Clamp           // recorta a maxCodeLen y alarga códigos hasta cumplir Kraft
+};
+
 class CanonicalHuffman {
 public:
     // Construye a partir de frecuencias (alphabetSize = frequencies.size()).
     // maxCodeLen típico 15.
-    void build(const std::vector<uint32_t>& frequencies, uint8_t maxCodeLen = 15);
+    void build(const std::vector<uint32_t>& frequencies, uint8_t maxCodeLen = 15,
+               LengthLimit limit = LengthLimit::PackageMerge);
 
     // Reconstruye desde longitudes (códigos canónicos deterministas).
     void loadFromCodeLengths(const std::vector<uint8_t>& codeLengths);
@@ -88,6 +127,20 @@ public:
     // Decodifica un símbolo leyendo bits LSB-first.
     uint32_t decodeSymbol(BitReader& br) const;
 
+    // Como decodeSymbol pero sin recargar: br debe tener maxCodeLength() bits cargados.
+    // Tras un refill (56 bits) alcanzan para 56 / maxCodeLength() símbolos seguidos.
+    uint32_t decodeLoaded(BitReader& br) const {
+        uint32_t bits = br.peek(maxLen_);
+        uint32_t e = table_[bits & ((1u << rootBits_) - 1)];
+        if (e & LINK)
+            e = table_[(e >> 8) + ((bits >> rootBits_) & ((1u << (e & 0x7F)) - 1))];
+        if (e == 0)
+            throw std::runtime_error("decodeSymbol: invalid code");
+        br.consume((int)(e & 0x7F));
+        return e >> 8;
+    }
+    int maxCodeLength() const { return maxLen_; }
+
     const std::vector<uint8_t>& codeLengths() const { return codeLen_; }
     const std::vector<Code>& codes() const { return codes_; }
 
@@ -96,10 +149,19 @@ private:
 
     std::vector<uint8_t>  codeLen_;
     std::vector<Code>     codes_;
-
-    // Tablas para decoder LSB-first (simples y seguras)
-    std::vector<uint32_t>              revCode_;    // código bit-revertido por símbolo
-    std::vector<std::vector<uint32_t>> byLenSyms_;  // símbolos agrupados por longitud
+    std::vector<uint32_t> revCodes_;   // código bit-revertido (orden de escritura LSB-first)
+
+    // Decoder por tablas: la tabla raíz se indexa con los próximos rootBits_ bits
+    // (LSB-first). Cada entrada es una hoja (símbolo << 8 | longitud) o, para códigos
+    // más largos, un enlace (offset << 8 | LINK | bits) a una subtabla al final de
+    // table_ indexada con los bits que siguen. 0 = código inválido.
+    static constexpr int      ROOT_BITS    = 10;
+    static constexpr int      MAX_CODE_LEN = 24;   // límite que acepta el decoder
+    static constexpr uint32_t LINK         = 0x80;
+
+    std::vector<uint32_t> table_;
+    int rootBits_ = 0;
+    int maxLen_ = 0;
 };
 
 // -------------- Stream simple (cabecera + bitstream) --------------
@@ -109,6 +171,72 @@ std::vector<uint8_t> encodeHuffmanStream(const std::vector<uint32_t>& symbols,
                                          uint32_t alphabetSize,
                                          uint8_t maxCodeLen = 15);
 
+// -------------- Stream intercalado (4 bitstreams) --------------
+// El símbolo i va al bitstream i % 4, así el decoder avanza 4 cadenas de dependencia
+// independientes por iteración. Formato:
+// [u16 0][u8 STREAM_X4][u16 alphabet_size][code_lens][u32 num_symbols]
+// [u32 tamaño s0][u32 tamaño s1][u32 tamaño s2][s0][s1][s2][s3]
+// Con menos de X4_MIN_SYMBOLS símbolos produce el stream simple (no compensa la tabla).
+//
+// Desde SYNC_MIN_SYMBOLS símbolos se agrega un índice de puntos de sincronización: cada
+// SYNC_INTERVAL símbolos, el bit en el que está cada bitstream. Los bitstreams son los
+// mismos; el decoder arranca un hilo en cada punto y llena rangos disjuntos de la salida.
+// [u16 0][u8 STREAM_X4_SYNC][u16 alphabet_size][code_lens][u32 num_symbols]
+// [u32 sync_interval][por punto k >= 1: 4 x u32 bit de s0..s3 en el símbolo k * sync_interval]
+// [u32 tamaño s0][u32 tamaño s1][u32 tamaño s2][s0][s1][s2][s3]
+constexpr uint8_t STREAM_X4       = 1;
+constexpr size_t  X4_MIN_SYMBOLS  = 4096;
+constexpr uint8_t STREAM_X4_SYNC  = 3;
+constexpr size_t  SYNC_INTERVAL   = 1 << 14;              // múltiplo de 4
+constexpr size_t  SYNC_MIN_SYMBOLS = 2 * SYNC_INTERVAL;
+
+std::vector<uint8_t> encodeHuffmanStreamX4(const std::vector<uint32_t>& symbols,
+                                           uint32_t alphabetSize,
+                                           uint8_t maxCodeLen = 15);
+
+// -------------- Stream por bloques (tabla adaptativa) --------------
+// Cada bloque de BLOCK_SYMBOLS símbolos trae su propia tabla o reutiliza la del bloque
+// anterior, así un archivo con partes de distinto contenido no paga una tabla promedio.
+// Las longitudes de código van comprimidas como en DEFLATE (RLE + Huffman de longitudes).
+// Los bloques se codifican y decodifican en paralelo. Formato:
+// [u16 0][u8 STREAM_BLOCKED][u16 alphabet_size][u32 num_symbols][u32 block_symbols]
+// por bloque: [u8 BLOCK_NEW_TABLE | BLOCK_REUSE_TABLE][tabla compacta si es nueva]
+//             [u32 tamaño][4 bitstreams como STREAM_X4: tamaños s0..s2 y datos]
+// Cada bloque ya es un punto de arranque independiente; si todo entra en un bloque
+// produce el stream X4 (con índice si es lo bastante largo).
+constexpr uint8_t STREAM_BLOCKED    = 2;
+constexpr size_t  BLOCK_SYMBOLS     = 1 << 17;   // 128 Ki símbolos por bloque
+constexpr uint8_t BLOCK_NEW_TABLE   = 0;
+constexpr uint8_t BLOCK_REUSE_TABLE = 1;
+
+std::vector<uint8_t> encodeHuffmanStreamBlocked(const std::vector<uint32_t>& symbols,
+                                                uint32_t alphabetSize,
+                                                uint8_t maxCodeLen = 15);
+
+// Decodifica cualquiera de los formatos
 std::vector<uint32_t> decodeHuffmanStream(const uint8_t* data, size_t size);
 
+// -------------- Símbolos en su tipo original --------------
+// Versiones con puntero + cantidad que leen los símbolos como vienen (los bytes del LZ77,
+// por ejemplo) y decodifican directo a un buffer del llamador, sin pasar por un
+// vector<uint32_t> de 4 bytes por símbolo. Producen y leen los mismos formatos que las
+// de arriba. Instanciadas para uint8_t, uint16_t y uint32_t.
+template <typename Sym>
+std::vector<uint8_t> encodeHuffmanStream(const Sym* symbols, size_t count,
+                                         uint32_t alphabetSize, uint8_t maxCodeLen = 15);
+template <typename Sym>
+std::vector<uint8_t> encodeHuffmanStreamX4(const Sym* symbols, size_t count,
+                                           uint32_t alphabetSize, uint8_t maxCodeLen = 15);
+template <typename Sym>
+std::vector<uint8_t> encodeHuffmanStreamBlocked(const Sym* symbols, size_t count,
+                                                uint32_t alphabetSize, uint8_t maxCodeLen = 15);
+
+// Cantidad de símbolos que trae un stream (para dimensionar el buffer de salida)
+size_t decodedSymbolCount(const uint8_t* data, size_t size);
+
+// Decodifica en out (capacity símbolos) y devuelve cuántos escribió. Lanza si no entran
+// o si el alfabeto del stream no cabe en Sym.
+template <typename Sym>
+size_t decodeHuffmanStreamInto(const uint8_t* data, size_t size, Sym* out, size_t capacity);
+
 } // namespace huff
@@ -1,6 +1,13 @@
 #include "lz77.h"
 #include <cstring>
 #include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <memory>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 // ============== HELPERS ==============
 static inline void writeLiteral(std::vector<uint8_t>& out, uint8_t byte) {
@@ -12,7 +19,12 @@ static inline void writeLiteral(std::vector<uint8_t>& out, uint8_t byte) {
     }
 }
 
-static inline void writeReference(std::vector<uint8_t>& out, uint16_t length, uint16_t distance) {
+// En formato Wide las distancias menores a 2^15 se escriben igual que en Classic
+// (así el stream de bytes conserva su estadística) y las demás ocupan 4 bytes
+static constexpr uint32_t WIDE_LONG_FLAG = 0x8000;
+
+static inline void writeReference(std::vector<uint8_t>& out, uint16_t length, uint32_t distance,
+                                  LZ77::Format format) {
     out.push_back(0x80);
     
     if (length < 255) {
@@ -23,8 +35,16 @@ static inline void writeReference(std::vector<uint8_t>& out, uint16_t length, ui
         out.push_back((uint8_t)(length >> 8));
     }
     
-    out.push_back((uint8_t)(distance & 0xFF));
-    out.push_back((uint8_t)(distance >> 8));
+    if (format == LZ77::Format::Classic || distance < WIDE_LONG_FLAG) {
+        out.push_back((uint8_t)(distance & 0xFF));
+        out.push_back((uint8_t)(distance >> 8));
+    } else {
+        // Distancia lejana: 31 bits, con el bit alto del segundo byte como marca
+        out.push_back((uint8_t)(distance & 0xFF));
+        out.push_back((uint8_t)(((distance >> 8) & 0x7F) | 0x80));
+        out.push_back((uint8_t)((distance >> 15) & 0xFF));
+        out.push_back((uint8_t)(distance >> 23));
+    }
 }
 
 static inline int calculateLiteralCost(const uint8_t* data, size_t len) {
@@ -35,121 +55,768 @@ static inline int calculateLiteralCost(const uint8_t* data, size_t len) {
     return cost;
 }
 
-static inline int calculateReferenceCost(uint16_t length) {
-    return (length < 255) ? 4 : 6;
+static inline int calculateReferenceCost(uint16_t length, uint32_t distance, LZ77::Format format) {
+    int length_cost = (length < 255) ? 2 : 4;   // marcador + longitud
+    int distance_cost = (format == LZ77::Format::Classic || distance < WIDE_LONG_FLAG) ? 2 : 4;
+    return length_cost + distance_cost;
+}
+
+// ============== LONGITUD DE MATCH ==============
+// Comparar byte a byte es el lazo más caliente del compresor. Se compara de a 8 bytes
+// (XOR + ctz: el primer bit distinto dice cuántos bytes coinciden) y, para la cola
+// de los matches largos, de a 16/32 bytes con SSE2/AVX2 elegido en tiempo de ejecución.
+
+static inline uint64_t load64(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Bytes iguales al inicio de dos palabras distintas (x = a ^ b != 0)
+static inline size_t equalPrefixBytes(uint64_t x) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return (size_t)__builtin_clzll(x) >> 3;
+#else
+    return (size_t)__builtin_ctzll(x) >> 3;
+#endif
+}
+
+// Versión portable: de a 8 bytes y el resto byte a byte
+static size_t matchLengthWords(const uint8_t* a, const uint8_t* b, size_t max_len) {
+    size_t len = 0;
+    while (len + 8 <= max_len) {
+        uint64_t x = load64(a + len) ^ load64(b + len);
+        if (x != 0) return len + equalPrefixBytes(x);
+        len += 8;
+    }
+    while (len < max_len && a[len] == b[len]) {
+        len++;
+    }
+    return len;
+}
+
+#if defined(__x86_64__)
+static size_t matchLengthSSE2(const uint8_t* a, const uint8_t* b, size_t max_len) {
+    size_t len = 0;
+    while (len + 16 <= max_len) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + len));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + len));
+        unsigned diff = ~(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) & 0xFFFF;
+        if (diff != 0) return len + (size_t)__builtin_ctz(diff);
+        len += 16;
+    }
+    return len + matchLengthWords(a + len, b + len, max_len - len);
 }
 
-// Búsqueda simple en ventana deslizante
-static LZ77::Match findBestMatch(const std::vector<uint8_t>& input, 
-                                  size_t pos, 
-                                  size_t window_size) {
+__attribute__((target("avx2")))
+static size_t matchLengthAVX2(const uint8_t* a, const uint8_t* b, size_t max_len) {
+    size_t len = 0;
+    while (len + 32 <= max_len) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + len));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + len));
+        unsigned diff = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb));
+        if (diff != 0) return len + (size_t)__builtin_ctz(diff);
+        len += 32;
+    }
+    return len + matchLengthSSE2(a + len, b + len, max_len - len);
+}
+#endif
+
+using MatchLengthFn = size_t (*)(const uint8_t*, const uint8_t*, size_t);
+
+static MatchLengthFn selectMatchLength() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return matchLengthAVX2;
+    return matchLengthSSE2;  // SSE2 es parte de x86-64
+#else
+    return matchLengthWords;
+#endif
+}
+
+static const MatchLengthFn matchLengthWide = selectMatchLength();
+
+// Cuántos bytes coinciden entre a y b (máximo max_len). La mayoría de los candidatos
+// difiere en los primeros 8 bytes, así que ese caso se resuelve en línea.
+static inline size_t matchLength(const uint8_t* a, const uint8_t* b, size_t max_len) {
+    if (max_len >= 8) {
+        uint64_t x = load64(a) ^ load64(b);
+        if (x != 0) return equalPrefixBytes(x);
+        return 8 + matchLengthWide(a + 8, b + 8, max_len - 8);
+    }
+    size_t len = 0;
+    while (len < max_len && a[len] == b[len]) {
+        len++;
+    }
+    return len;
+}
+
+// ============== BUSCADOR DE COINCIDENCIAS ==============
+
+// Tabla por nivel: {max_chain, nice_length}
+static const LZ77::LevelParams LEVEL_TABLE[LZ77::MAX_LEVEL + 1] = {
+    {   0,   0},  // 0: sin uso
+    {   4,   8},  // 1: lo más rápido
+    {   8,  16},
+    {  16,  32},
+    {  32,  64},
+    {  64, 128},
+    { 128, 128},  // 6: por defecto
+    { 256, 258},
+    {1024, 258},
+    {4096, 258},  // 9: mejor ratio
+};
+
+LZ77::LevelParams LZ77::paramsForLevel(int level) {
+    if (level < MIN_LEVEL) level = MIN_LEVEL;
+    if (level > MAX_LEVEL) level = MAX_LEVEL;
+    return LEVEL_TABLE[level];
+}
+
+size_t LZ77::windowSize(const Options& options) {
+    if (options.window_log <= DEFAULT_WINDOW_LOG) return WINDOW_SIZE;
+    int log = std::min(std::max(options.window_log, MIN_LONG_WINDOW_LOG), MAX_LONG_WINDOW_LOG);
+    return size_t(1) << log;
+}
+
+LZ77::Format LZ77::formatFor(const Options& options) {
+    return (options.window_log > DEFAULT_WINDOW_LOG) ? Format::Wide : Format::Classic;
+}
+
+// Cadenas hash: head[h] guarda la última posición con hash h y prev[pos % ventana]
+// la posición anterior con el mismo hash. Así solo se revisan candidatos que
+// comparten los primeros 3 bytes en vez de toda la ventana.
+class HashChain {
+public:
+    static constexpr int    HASH_BITS = 16;
+    static constexpr size_t HASH_SIZE = size_t(1) << HASH_BITS;
+    static constexpr size_t NIL       = SIZE_MAX;
+
+    HashChain(const uint8_t* data, size_t size, size_t window_size)
+        : data_(data),
+          size_(size),
+          window_size_(window_size),
+          mask_(window_size - 1),
+          head_(HASH_SIZE, NIL),
+          prev_(window_size, NIL) {}
+
+    // Registra pos como inicio de una posible coincidencia
+    void insert(size_t pos) {
+        if (pos + LZ77::MIN_MATCH_LEN > size_) return;
+        uint32_t h = hash3(data_ + pos);
+        prev_[pos & mask_] = head_[h];
+        head_[h] = pos;
+    }
+
+    size_t head(size_t pos) const { return head_[hash3(data_ + pos)]; }
+
+    // Siguiente candidato de la cadena (NIL si se acabó o quedó fuera de la ventana)
+    size_t next(size_t cand) const {
+        size_t p = prev_[cand & mask_];
+        // Un valor >= cand significa que la ranura fue reutilizada por una posición posterior
+        return (p == NIL || p >= cand) ? NIL : p;
+    }
+
+    size_t windowSize() const { return window_size_; }
+    size_t size() const { return size_; }
+
+private:
+    static inline uint32_t hash3(const uint8_t* p) {
+        uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+        return (v * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t window_size_;
+    size_t mask_;
+    std::vector<size_t> head_;
+    std::vector<size_t> prev_;
+};
+
+// Recorre la cadena hash de pos (máximo max_chain candidatos) y devuelve el match más largo.
+// El match nunca pasa de end.
+static LZ77::Match findBestMatch(const uint8_t* data,
+                                  size_t pos,
+                                  size_t end,
+                                  const HashChain& chain,
+                                  const LZ77::LevelParams& params) {
     LZ77::Match best(0, 0);
     
-    size_t lookahead_len = std::min(LZ77::LOOKAHEAD_SIZE, input.size() - pos);
+    size_t lookahead_len = std::min(LZ77::LOOKAHEAD_SIZE, end - pos);
     if (lookahead_len < LZ77::MIN_MATCH_LEN) {
         return best;
     }
     
-    // Determinar inicio de la ventana
-    size_t window_start = (pos > window_size) ? pos - window_size : 0;
+    const size_t nice_len = std::min<size_t>(params.nice_length, lookahead_len);
+    const uint8_t* cur = data + pos;
+    unsigned chain_left = params.max_chain;
     
-    // Buscar en la ventana
-    for (size_t i = window_start; i < pos; ++i) {
-        size_t len = 0;
-        size_t max_len = std::min(lookahead_len, input.size() - pos);
+    for (size_t cand = chain.head(pos); cand != HashChain::NIL && chain_left > 0;
+         cand = chain.next(cand), --chain_left) {
+        size_t distance = pos - cand;
+        if (distance > chain.windowSize()) break;
         
-        // Comparar bytes
-        while (len < max_len && input[i + len] == input[pos + len]) {
-            len++;
-        }
+        const uint8_t* ref = data + cand;
+        // Descarte rápido: si no mejora en el byte best.length, no vale la pena comparar
+        if (ref[best.length] != cur[best.length]) continue;
+        
+        size_t len = matchLength(ref, cur, lookahead_len);
         
-        // Si encontramos un match mejor
         if (len >= LZ77::MIN_MATCH_LEN && len > best.length) {
             best.length = len;
-            best.position = pos - i;
+            best.position = distance;
+            if (len >= nice_len) break;
         }
     }
     
     return best;
 }
 
-// ============== COMPRESIÓN ==============
-std::vector<uint8_t> LZ77::compress(const std::vector<uint8_t>& input) {
-    const size_t N = input.size();
-    if (N == 0) return {};
-    
-    std::vector<uint8_t> out;
-    out.reserve(N / 2);
-    
-    size_t pos = 0;
-    
-    while (pos < N) {
-        // Buscar mejor match
-        Match best = findBestMatch(input, pos, WINDOW_SIZE);
+// Buscador de repeticiones lejanas para el modo de ventana larga. Guarda huellas de
+// KEY_LEN bytes tomadas cada `stride` posiciones en una tabla de tamaño fijo y se
+// consulta en todas las posiciones: una región repetida se encuentra como mucho
+// stride bytes después de empezar, sin importar lo lejos que esté la copia.
+class LongMatcher {
+public:
+    static constexpr int    TABLE_LOG = 20;   // 1M entradas (4 MiB)
+    static constexpr size_t KEY_LEN   = 8;
+    static constexpr size_t MIN_LEN   = 32;   // más corto no compensa una distancia larga
+
+    // Las posiciones se guardan relativas a base (el inicio del diccionario)
+    LongMatcher(const uint8_t* data, size_t size, size_t base, size_t window)
+        : data_(data),
+          size_(size),
+          base_(base),
+          window_(window),
+          stride_(std::max<size_t>(8, window >> TABLE_LOG)),
+          table_(size_t(1) << TABLE_LOG, 0) {}
+
+    void insert(size_t pos) {
+        if (pos % stride_ != 0 || pos + KEY_LEN > size_ || pos - base_ >= UINT32_MAX) return;
+        table_[hash(pos)] = (uint32_t)(pos - base_ + 1);
+    }
+
+    // Carga las posiciones muestreadas de [from, to) sin recorrer las demás
+    void prime(size_t from, size_t to) {
+        for (size_t p = (from + stride_ - 1) / stride_ * stride_; p < to; p += stride_) {
+            insert(p);
+        }
+    }
+
+    LZ77::Match find(size_t pos, size_t end, size_t max_len) const {
+        if (pos + KEY_LEN > end) return LZ77::Match();
+        uint32_t entry = table_[hash(pos)];
+        if (entry == 0) return LZ77::Match();
+        size_t cand = base_ + entry - 1;
+        if (cand >= pos || pos - cand > window_) return LZ77::Match();
+        size_t len = matchLength(data_ + cand, data_ + pos, max_len);
+        if (len < MIN_LEN) return LZ77::Match();
+        return LZ77::Match((uint32_t)(pos - cand), (uint16_t)len);
+    }
+
+private:
+    uint32_t hash(size_t pos) const {
+        uint64_t v;
+        std::memcpy(&v, data_ + pos, sizeof(v));
+        return (uint32_t)((v * 0x9E3779B97F4A7C15ull) >> (64 - TABLE_LOG));
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t base_;
+    size_t window_;
+    size_t stride_;
+    std::vector<uint32_t> table_;
+};
+
+// Buscador que usan los parsers: cadenas hash sobre los últimos WINDOW_SIZE bytes y,
+// con ventana larga, LongMatcher más la última distancia lejana usada.
+class MatchFinder {
+public:
+    MatchFinder(const uint8_t* data, size_t size, const LZ77::Options& options)
+        : data_(data),
+          chain_(data, size, LZ77::WINDOW_SIZE),
+          params_(LZ77::paramsForLevel(options.level)),
+          format_(LZ77::formatFor(options)),
+          window_(LZ77::windowSize(options)) {}
+
+    // Carga como diccionario lo que precede a begin
+    void prime(size_t begin) {
+        size_t near_start = (begin > LZ77::WINDOW_SIZE) ? begin - LZ77::WINDOW_SIZE : 0;
+        for (size_t p = near_start; p < begin; ++p) {
+            chain_.insert(p);
+        }
+        if (format_ == LZ77::Format::Wide) {
+            size_t far_start = (begin > window_) ? begin - window_ : 0;
+            long_.reset(new LongMatcher(data_, chain_size(), far_start, window_));
+            long_->prime(far_start, begin);
+        }
+    }
+
+    void insert(size_t pos) {
+        chain_.insert(pos);
+        if (long_) long_->insert(pos);
+    }
+
+    LZ77::Match find(size_t pos, size_t end) {
+        LZ77::Match best = findBestMatch(data_, pos, end, chain_, params_);
+        if (!long_) return best;
         
-        // Decidir si usar referencia o literal
-        bool use_reference = false;
+        const size_t max_len = std::min(LZ77::LONG_MATCH_MAX, end - pos);
         
-        if (best.length >= MIN_MATCH_LEN) {
-            int literal_cost = calculateLiteralCost(&input[pos], best.length);
-            int ref_cost = calculateReferenceCost(best.length);
-            use_reference = (ref_cost < literal_cost);
+        // Un match cercano que llegó al tope de DEFLATE se sigue extendiendo
+        if (best.length == LZ77::LOOKAHEAD_SIZE) {
+            best.length = (uint16_t)matchLength(data_ + pos - best.position, data_ + pos, max_len);
+        }
+        
+        // Las regiones repetidas suelen continuar: probar primero la última distancia lejana
+        if (rep_ != 0 && rep_ <= pos && rep_ <= window_) {
+            size_t len = matchLength(data_ + pos - rep_, data_ + pos, max_len);
+            if (len >= LZ77::MIN_MATCH_LEN && len > best.length) {
+                best = LZ77::Match((uint32_t)rep_, (uint16_t)len);
+            }
         }
         
-        if (use_reference) {
-            writeReference(out, best.length, best.position);
+        LZ77::Match far = long_->find(pos, end, max_len);
+        if (far.length > best.length) best = far;
+        
+        if (best.position > LZ77::WINDOW_SIZE) rep_ = best.position;
+        return best;
+    }
+
+    const LZ77::LevelParams& params() const { return params_; }
+    LZ77::Format format() const { return format_; }
+
+private:
+    size_t chain_size() const { return chain_.size(); }
+
+    const uint8_t* data_;
+    HashChain chain_;
+    LZ77::LevelParams params_;
+    LZ77::Format format_;
+    size_t window_;
+    std::unique_ptr<LongMatcher> long_;
+    size_t rep_ = 0;
+};
+
+// ============== PARSEO ==============
+// Cada parser recorre el tramo [begin, end) de data. Las posiciones anteriores a begin
+// que ya estén cargadas en el buscador sirven como diccionario.
+
+// Una referencia solo vale la pena si cuesta menos bytes que escribir sus literales
+static inline bool worthReference(const uint8_t* data, size_t pos, const LZ77::Match& m,
+                                  LZ77::Format format) {
+    return m.length >= LZ77::MIN_MATCH_LEN &&
+           calculateReferenceCost(m.length, m.position, format) < calculateLiteralCost(data + pos, m.length);
+}
+
+// Greedy: toma siempre el match más largo en pos
+static void parseGreedy(const uint8_t* data, size_t begin, size_t end, MatchFinder& finder,
+                        std::vector<uint8_t>& out) {
+    size_t pos = begin;
+    
+    while (pos < end) {
+        // Buscar mejor match
+        LZ77::Match best = finder.find(pos, end);
+        
+        if (worthReference(data, pos, best, finder.format())) {
+            writeReference(out, best.length, best.position, finder.format());
+            for (size_t k = 0; k < best.length; ++k) {
+                finder.insert(pos + k);
+            }
             pos += best.length;
         } else {
-            writeLiteral(out, input[pos]);
+            writeLiteral(out, data[pos]);
+            finder.insert(pos);
             pos++;
         }
     }
+}
+
+// Lazy de un paso: antes de usar el match en pos mira el de pos+1; si es más largo,
+// emite pos como literal y se queda con el siguiente
+static void parseLazy(const uint8_t* data, size_t begin, size_t end, MatchFinder& finder,
+                      std::vector<uint8_t>& out) {
+    size_t pos = begin;
+    size_t inserted = begin;   // posiciones [begin, inserted) ya están en la cadena
+    auto insertUntil = [&](size_t p) {
+        while (inserted < p) finder.insert(inserted++);
+    };
+    
+    LZ77::Match cur;
+    bool have_cur = false;
+    
+    while (pos < end) {
+        insertUntil(pos);
+        if (!have_cur) cur = finder.find(pos, end);
+        have_cur = false;
+        
+        if (!worthReference(data, pos, cur, finder.format())) {
+            writeLiteral(out, data[pos]);
+            pos++;
+            continue;
+        }
+        
+        if (cur.length < finder.params().nice_length && pos + 1 < end) {
+            insertUntil(pos + 1);
+            LZ77::Match next = finder.find(pos + 1, end);
+            if (next.length > cur.length && worthReference(data, pos + 1, next, finder.format())) {
+                writeLiteral(out, data[pos]);
+                pos++;
+                cur = next;
+                have_cur = true;
+                continue;
+            }
+        }
+        
+        writeReference(out, cur.length, cur.position, finder.format());
+        pos += cur.length;
+    }
+}
+
+// Tamaño de los tramos del parseo óptimo (acota la memoria de las tablas de costo)
+static constexpr size_t OPTIMAL_SEGMENT = 1 << 20;
+
+// Óptimo: camino más corto sobre los costos en bytes de calculateLiteralCost /
+// calculateReferenceCost. Basta con el match más largo de cada posición: cualquier
+// longitud menor reutiliza la misma distancia. Los matches de ventana larga que pasan
+// de LOOKAHEAD_SIZE solo se relajan con su longitud completa.
+static void parseOptimal(const uint8_t* data, size_t begin, size_t end, MatchFinder& finder,
+                         std::vector<uint8_t>& out) {
+    std::vector<uint32_t> price;
+    std::vector<LZ77::Match> choice;   // cómo se llega a cada posición (length 0 = literal)
+    std::vector<LZ77::Match> path;
+    
+    for (size_t seg = begin; seg < end; seg += OPTIMAL_SEGMENT) {
+        const size_t seg_end = std::min(end, seg + OPTIMAL_SEGMENT);
+        const size_t n = seg_end - seg;
+        
+        price.assign(n + 1, UINT32_MAX);
+        choice.assign(n + 1, LZ77::Match());
+        price[0] = 0;
+        
+        // 1) Relajar aristas hacia adelante
+        for (size_t i = 0; i < n; ++i) {
+            const size_t pos = seg + i;
+            const uint32_t base = price[i];
+            
+            uint32_t lit = base + (uint32_t)calculateLiteralCost(data + pos, 1);
+            if (lit < price[i + 1]) {
+                price[i + 1] = lit;
+                choice[i + 1] = LZ77::Match(0, 0);
+            }
+            
+            LZ77::Match m = finder.find(pos, seg_end);
+            finder.insert(pos);
+            
+            auto relax = [&](size_t len) {
+                uint32_t c = base + (uint32_t)calculateReferenceCost((uint16_t)len, m.position, finder.format());
+                if (c < price[i + len]) {
+                    price[i + len] = c;
+                    choice[i + len] = LZ77::Match(m.position, (uint16_t)len);
+                }
+            };
+            const size_t short_max = std::min<size_t>(m.length, LZ77::LOOKAHEAD_SIZE);
+            for (size_t len = LZ77::MIN_MATCH_LEN; len <= short_max; ++len) {
+                relax(len);
+            }
+            if (m.length > LZ77::LOOKAHEAD_SIZE) {
+                // Repetición lejana larga: se toma entera y se saltan las posiciones que
+                // cubre (buscar en cada una volvería a extender el mismo match)
+                relax(m.length);
+                for (size_t k = 1; k < m.length; ++k) {
+                    finder.insert(pos + k);
+                }
+                i += m.length - 1;
+            }
+        }
+        
+        // 2) Reconstruir el camino desde el final
+        path.clear();
+        for (size_t i = n; i > 0; ) {
+            const LZ77::Match& c = choice[i];
+            path.push_back(c);
+            i -= (c.length == 0) ? 1 : c.length;
+        }
+        
+        // 3) Emitir en orden
+        size_t pos = seg;
+        for (auto it = path.rbegin(); it != path.rend(); ++it) {
+            if (it->length == 0) {
+                writeLiteral(out, data[pos]);
+                pos++;
+            } else {
+                writeReference(out, it->length, it->position, finder.format());
+                pos += it->length;
+            }
+        }
+    }
+}
+
+// Comprime el bloque [begin, end) de data. Lo que precede a begin (WINDOW_SIZE bytes,
+// o la ventana larga completa) se carga primero en el buscador como diccionario, así
+// el bloque puede referenciar el bloque anterior igual que en una pasada secuencial.
+static std::vector<uint8_t> compressBlock(const uint8_t* data, size_t begin, size_t end,
+                                          const LZ77::Options& options) {
+    std::vector<uint8_t> out;
+    out.reserve((end - begin) / 2);
+    
+    MatchFinder finder(data, end, options);
+    finder.prime(begin);
+    
+    switch (options.parse) {
+    case LZ77::Parse::Lazy:
+        parseLazy(data, begin, end, finder, out);
+        break;
+    case LZ77::Parse::Optimal:
+        parseOptimal(data, begin, end, finder, out);
+        break;
+    case LZ77::Parse::Greedy:
+    default:
+        parseGreedy(data, begin, end, finder, out);
+        break;
+    }
     
     return out;
 }
 
-// ============== DESCOMPRESIÓN ==============
-std::vector<uint8_t> LZ77::decompress(const std::vector<uint8_t>& input) {
+// ============== COMPRESIÓN ==============
+std::vector<uint8_t> LZ77::compress(const std::vector<uint8_t>& input) {
+    return compress(input, Options());
+}
+
+std::vector<uint8_t> LZ77::compress(const std::vector<uint8_t>& input, const Options& options) {
+    return compressWithDictionary(input.data(), input.size(), 0, options);
+}
+
+std::vector<uint8_t> LZ77::compressWithDictionary(const uint8_t* data, size_t size,
+                                                  size_t dict_size, const Options& options) {
+    if (dict_size >= size) return {};
+    const size_t N = size - dict_size;
+    
+    const size_t block_size = options.block_size ? options.block_size : N;
+    const size_t num_blocks = (N + block_size - 1) / block_size;
+    
+    if (num_blocks == 1) {
+        return compressBlock(data, dict_size, size, options);
+    }
+    
+    // Los bloques se comprimen en paralelo y se concatenan en orden. Los cortes
+    // dependen solo de block_size, así que la salida es la misma con cualquier
+    // número de hilos.
+    std::vector<std::vector<uint8_t>> parts(num_blocks);
+    
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t b = 0; b < num_blocks; ++b) {
+        size_t begin = dict_size + b * block_size;
+        size_t end = std::min(size, begin + block_size);
+        parts[b] = compressBlock(data, begin, end, options);
+    }
+    
+    size_t total = 0;
+    for (const auto& part : parts) total += part.size();
+    
     std::vector<uint8_t> out;
-    out.reserve(input.size() * 3);
+    out.reserve(total);
+    for (auto& part : parts) {
+        out.insert(out.end(), part.begin(), part.end());
+        std::vector<uint8_t>().swap(part);
+    }
     
-    size_t p = 0;
-    const size_t N = input.size();
+    return out;
+}
+
+// ============== DESCOMPRESIÓN ==============
+
+// Holgura que necesita la copia ancha: puede escribir hasta 31 bytes más allá del match
+static constexpr size_t COPY_SLACK = 32;
+
+static inline void copy8(uint8_t* dst, const uint8_t* src)  { std::memcpy(dst, src, 8); }
+static inline void copy16(uint8_t* dst, const uint8_t* src) { std::memcpy(dst, src, 16); }
+static inline void copy32(uint8_t* dst, const uint8_t* src) { std::memcpy(dst, src, 32); }
+
+// Copia un match de length bytes desde op - distance con escrituras de 8/16/32 bytes.
+// Puede escribir hasta COPY_SLACK bytes de más después de op + length.
+static inline void wideCopyMatch(uint8_t* op, size_t distance, size_t length) {
+    const uint8_t* src = op - distance;
+    uint8_t* const end = op + length;
     
-    while (p < N) {
-        uint8_t first = input[p++];
+    if (distance >= 32) {
+        do { copy32(op, src); op += 32; src += 32; } while (op < end);
+        return;
+    }
+    if (distance >= 16) {
+        do { copy16(op, src); op += 16; src += 16; } while (op < end);
+        return;
+    }
+    
+    // Distancias cortas (solapadas): se duplica el patrón copiando bloques que no se
+    // pisan (op - src crece d, 2d, 4d...) hasta que la separación llegue a 8 bytes
+    size_t gap = distance;
+    while (gap < 8 && op < end) {
+        std::memcpy(op, src, gap);
+        op += gap;
+        gap *= 2;
+    }
+    while (op < end) {
+        copy8(op, src);
+        op += 8;
+        src += 8;
+    }
+}
+
+// Valida una referencia y la copia en op (que avanza). Con COPY_SLACK libre usa las
+// copias anchas; cerca del final del buffer copia byte a byte sin pasarse.
+static inline void checkedCopyMatch(uint8_t* out, uint8_t*& op, uint8_t* oend, size_t dict_size,
+                                    size_t distance, size_t length) {
+    const size_t produced = (size_t)(op - out);
+    if (distance == 0 || length == 0 || distance > produced + dict_size) {
+        throw std::runtime_error("LZ77: referencia inválida");
+    }
+    const size_t room = (size_t)(oend - op);
+    if (length > room) throw std::runtime_error("LZ77: la salida no cabe en el buffer");
+    
+    if (room >= length + COPY_SLACK) {
+        wideCopyMatch(op, distance, length);
+    } else {
+        const uint8_t* src = op - distance;
+        for (size_t i = 0; i < length; ++i) op[i] = src[i];
+    }
+    op += length;
+}
+
+// Lee la distancia de una referencia según el formato; false si está truncada
+static inline bool readDistance(const uint8_t*& ip, const uint8_t* iend, LZ77::Format format,
+                                size_t& distance) {
+    if (format == LZ77::Format::Classic) {
+        if (iend - ip < 2) return false;
+        distance = ip[0] | (ip[1] << 8);
+        ip += 2;
+        return true;
+    }
+    if (iend - ip < 2) return false;
+    distance = ip[0] | ((ip[1] & 0x7F) << 8);
+    if (ip[1] & 0x80) {
+        if (iend - ip < 4) return false;
+        distance |= ((size_t)ip[2] << 15) | ((size_t)ip[3] << 23);
+        ip += 4;
+    } else {
+        ip += 2;
+    }
+    return true;
+}
+
+size_t LZ77::decompressedSize(const uint8_t* input, size_t size, Format format) {
+    size_t total = 0;
+    const uint8_t* ip = input;
+    const uint8_t* const iend = input + size;
+    
+    while (ip < iend) {
+        uint8_t first = *ip++;
         
         if (first < 0x80) {
-            out.push_back(first);
-        } 
-        else if (first == 0xFF) {
-            if (p >= N) break;
-            out.push_back(input[p++]);
-        }
-        else {
-            if (p >= N) break;
-            
-            uint16_t length = input[p++];
+            total++;
+        } else if (first == 0xFF) {
+            if (ip >= iend) throw std::runtime_error("LZ77: literal truncado");
+            ip++;
+            total++;
+        } else {
+            if (ip >= iend) throw std::runtime_error("LZ77: referencia truncada");
+            size_t length = *ip++;
             if (length == 0xFF) {
-                if (p + 1 >= N) break;
-                length = input[p] | (input[p + 1] << 8);
-                p += 2;
+                if (iend - ip < 2) throw std::runtime_error("LZ77: referencia truncada");
+                length = ip[0] | (ip[1] << 8);
+                ip += 2;
             }
-            
-            if (p + 1 >= N) break;
-            uint16_t distance = input[p] | (input[p + 1] << 8);
-            p += 2;
-            
-            if (distance == 0 || distance > out.size() || length == 0) {
-                break;
-            }
-            
-            size_t start = out.size() - distance;
-            for (size_t i = 0; i < length; ++i) {
-                out.push_back(out[start + i]);
+            size_t distance;
+            if (!readDistance(ip, iend, format, distance)) throw std::runtime_error("LZ77: referencia truncada");
+            total += length;
+        }
+    }
+    
+    return total;
+}
+
+size_t LZ77::decompressInto(const uint8_t* input, size_t size,
+                            uint8_t* out, size_t out_size, size_t dict_size, Format format) {
+    const uint8_t* ip = input;
+    const uint8_t* const iend = input + size;
+    uint8_t* op = out;
+    uint8_t* const oend = out + out_size;
+    
+    while (ip < iend) {
+        uint8_t first = *ip++;
+        
+        if (first < 0x80) {
+            if (op >= oend) throw std::runtime_error("LZ77: la salida no cabe en el buffer");
+            *op++ = first;
+            continue;
+        }
+        if (first == 0xFF) {
+            if (ip >= iend) throw std::runtime_error("LZ77: literal truncado");
+            if (op >= oend) throw std::runtime_error("LZ77: la salida no cabe en el buffer");
+            *op++ = *ip++;
+            continue;
+        }
+        
+        // Referencia: [0x80][len | 0xFF len_lo len_hi][dist_lo dist_hi (+2 bytes si Wide y bit alto)]
+        if (ip >= iend) throw std::runtime_error("LZ77: referencia truncada");
+        size_t length = *ip++;
+        if (length == 0xFF) {
+            if (iend - ip < 2) throw std::runtime_error("LZ77: referencia truncada");
+            length = ip[0] | (ip[1] << 8);
+            ip += 2;
+        }
+        size_t distance;
+        if (!readDistance(ip, iend, format, distance)) throw std::runtime_error("LZ77: referencia truncada");
+        
+        checkedCopyMatch(out, op, oend, dict_size, distance, length);
+    }
+    
+    return (size_t)(op - out);
+}
+
+std::vector<LZ77::Match> LZ77::tokenize(const uint8_t* input, size_t size, Format format) {
+    std::vector<Match> tokens;
+    tokens.reserve(size / 2);
+    const uint8_t* ip = input;
+    const uint8_t* const iend = input + size;
+    
+    while (ip < iend) {
+        uint8_t first = *ip++;
+        
+        if (first < 0x80) {
+            tokens.emplace_back(first, 0);
+        } else if (first == 0xFF) {
+            if (ip >= iend) throw std::runtime_error("LZ77: literal truncado");
+            tokens.emplace_back(*ip++, 0);
+        } else {
+            if (ip >= iend) throw std::runtime_error("LZ77: referencia truncada");
+            size_t length = *ip++;
+            if (length == 0xFF) {
+                if (iend - ip < 2) throw std::runtime_error("LZ77: referencia truncada");
+                length = ip[0] | (ip[1] << 8);
+                ip += 2;
             }
+            size_t distance;
+            if (!readDistance(ip, iend, format, distance)) throw std::runtime_error("LZ77: referencia truncada");
+            if (length == 0 || distance == 0) throw std::runtime_error("LZ77: referencia inválida");
+            tokens.emplace_back((uint32_t)distance, (uint16_t)length);
         }
     }
     
+    return tokens;
+}
+
+void LZ77::copyMatch(uint8_t* out, uint8_t*& op, uint8_t* oend, size_t dict_size,
+                     size_t distance, size_t length) {
+    checkedCopyMatch(out, op, oend, dict_size, distance, length);
+}
+
+std::vector<uint8_t> LZ77::decompress(const std::vector<uint8_t>& input, Format format) {
+    // Tamaño exacto primero (solo recorre los tokens) y luego decodifica sin realocar
+    std::vector<uint8_t> out(decompressedSize(input.data(), input.size(), format));
+    decompressInto(input.data(), input.size(), out.data(), out.size(), 0, format);
     return out;
-}
\ No newline at end of file
+}
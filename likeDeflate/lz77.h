@@ -1,6 +1,7 @@
 #ifndef LZ77_H
 #define LZ77_H
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
@@ -11,16 +12,92 @@ public:
     static constexpr size_t LOOKAHEAD_SIZE  = 258;    // Máximo DEFLATE
     static constexpr size_t MIN_MATCH_LEN   = 3;      // Mínimo útil
 
+    // Niveles de compresión (como zlib: 1 = rápido, 9 = mejor ratio)
+    static constexpr int MIN_LEVEL     = 1;
+    static constexpr int MAX_LEVEL     = 9;
+    static constexpr int DEFAULT_LEVEL = 6;
+
+    // Tamaño de bloque para la compresión paralela (cada bloque usa como
+    // diccionario los últimos WINDOW_SIZE bytes del anterior)
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 1 << 20;  // 1 MiB
+
+    // Ventana larga: de 1 MiB a 128 MiB (en log2). Con ventana larga los matches
+    // pueden llegar a LONG_MATCH_MAX bytes, el máximo que admite el formato.
+    static constexpr int    DEFAULT_WINDOW_LOG  = 15;     // WINDOW_SIZE
+    static constexpr int    MIN_LONG_WINDOW_LOG = 20;     // 1 MiB
+    static constexpr int    MAX_LONG_WINDOW_LOG = 27;     // 128 MiB
+    static constexpr size_t LONG_MATCH_MAX      = 65535;
+
+    // Formato de las referencias en el stream de bytes
+    enum class Format : uint8_t {
+        Classic = 0,  // [0x80][len][dist u16]: ventana de 32 KiB
+        Wide    = 1,  // como Classic; con el bit alto de dist_hi siguen 2 bytes más (31 bits)
+    };
+
     // Estructura interna para matches - AHORA PÚBLICA
     struct Match {
-        uint16_t position; // distancia hacia atrás
+        uint32_t position; // distancia hacia atrás
         uint16_t length;   // longitud del match
-        Match(uint16_t p=0, uint16_t l=0): position(p), length(l){}
+        Match(uint32_t p=0, uint16_t l=0): position(p), length(l){}
     };
 
+    // Parámetros del buscador de coincidencias para un nivel
+    struct LevelParams {
+        uint16_t max_chain;   // candidatos máximos a revisar en la cadena hash
+        uint16_t nice_length; // longitud "suficientemente buena": corta la búsqueda
+    };
+
+    // Estrategia de parseo: greedy (rápido), lazy de un paso, u óptimo por costos
+    enum class Parse : uint8_t { Greedy, Lazy, Optimal };
+
+    // Opciones de compresión
+    struct Options {
+        int level = DEFAULT_LEVEL;
+        Parse parse = Parse::Greedy;
+        size_t block_size = DEFAULT_BLOCK_SIZE;  // 0 = un solo bloque (sin paralelismo)
+        int window_log = DEFAULT_WINDOW_LOG;     // > 15 activa el modo de ventana larga
+    };
+
+    // Devuelve los parámetros del nivel (se recorta a [MIN_LEVEL, MAX_LEVEL])
+    static LevelParams paramsForLevel(int level);
+
+    // Tamaño de ventana y formato que resultan de las opciones
+    static size_t windowSize(const Options& options);
+    static Format formatFor(const Options& options);
+
     // API principal: compresión / descompresión de bytes
     static std::vector<uint8_t> compress(const std::vector<uint8_t>& input);
-    static std::vector<uint8_t> decompress(const std::vector<uint8_t>& input);
+    static std::vector<uint8_t> compress(const std::vector<uint8_t>& input, const Options& options);
+    static std::vector<uint8_t> decompress(const std::vector<uint8_t>& input,
+                                           Format format = Format::Classic);
+
+    // Comprime data[dict_size, size) usando data[0, dict_size) como diccionario.
+    // El diccionario no se emite: el decodificador debe tenerlo como historia
+    // (ver dict_size en decompressInto).
+    static std::vector<uint8_t> compressWithDictionary(const uint8_t* data, size_t size,
+                                                       size_t dict_size, const Options& options);
+
+    // Bytes que produce un stream LZ77 (solo recorre los tokens, no copia nada)
+    static size_t decompressedSize(const uint8_t* input, size_t size,
+                                   Format format = Format::Classic);
+
+    // Decodifica en un buffer del llamador de out_size bytes (tamaño conocido, p.ej.
+    // total_uncompressed). Los dict_size bytes inmediatamente antes de out se pueden
+    // referenciar como historia. Devuelve los bytes escritos; lanza std::runtime_error
+    // si el stream es inválido o no cabe.
+    static size_t decompressInto(const uint8_t* input, size_t size,
+                                 uint8_t* out, size_t out_size, size_t dict_size = 0,
+                                 Format format = Format::Classic);
+
+    // Separa el stream en tokens: length == 0 es un literal (position = el byte) y
+    // si no, una referencia (position = distancia). Lanza si el stream es inválido.
+    static std::vector<Match> tokenize(const uint8_t* input, size_t size,
+                                       Format format = Format::Classic);
+
+    // Copia una referencia en op (out es el inicio de la salida, con dict_size bytes
+    // de historia antes). Valida la distancia y que quepa antes de oend; avanza op.
+    static void copyMatch(uint8_t* out, uint8_t*& op, uint8_t* oend, size_t dict_size,
+                          size_t distance, size_t length);
 };
 
-#endif // LZ77_H
\ No newline at end of file
+#endif // LZ77_H
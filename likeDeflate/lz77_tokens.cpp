@@ -0,0 +1,176 @@
+#include "lz77_tokens.h"
+#include "huffman.h"
+#include "fse.h"
+#include "cm.h"
+#include <stdexcept>
+
+namespace lz77_tokens {
+
+// ---------- util ----------
+
+static void putU32(std::vector<uint8_t>& out, uint32_t v) {
+    out.push_back((uint8_t)(v & 0xFF));
+    out.push_back((uint8_t)((v >> 8) & 0xFF));
+    out.push_back((uint8_t)((v >> 16) & 0xFF));
+    out.push_back((uint8_t)((v >> 24) & 0xFF));
+}
+
+static uint32_t getU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Código de un valor y sus bits extra (ver el esquema en lz77_tokens.h)
+static inline uint32_t valueCode(uint32_t v, int& extra_bits, uint32_t& extra) {
+    if (v < 4) {
+        extra_bits = 0;
+        extra = 0;
+        return v;
+    }
+    int n = 31 - __builtin_clz(v);
+    extra_bits = n - 1;
+    extra = v & ((1u << extra_bits) - 1);
+    return 2 * (uint32_t)n + ((v >> extra_bits) & 1);
+}
+
+// Valor base de un código y cuántos bits extra lo siguen
+static inline uint32_t codeBase(uint32_t code, int& extra_bits) {
+    if (code < 4) {
+        extra_bits = 0;
+        return code;
+    }
+    int n = (int)(code / 2);
+    extra_bits = n - 1;
+    return (2u | (code & 1)) << extra_bits;
+}
+
+// Tamaño mínimo de alfabeto que cubre todos los símbolos
+template <typename Sym>
+static uint32_t usedAlphabet(const std::vector<Sym>& symbols) {
+    uint32_t max_sym = 0;
+    for (Sym s : symbols) {
+        if (s > max_sym) max_sym = s;
+    }
+    return max_sym + 1;
+}
+
+// Codifica una sección con el backend elegido
+template <typename Sym>
+static std::vector<uint8_t> encodeSection(const std::vector<Sym>& symbols, Entropy entropy) {
+    if (entropy == Entropy::Fse) {
+        return fse::encodeStream(symbols.data(), symbols.size(), usedAlphabet(symbols));
+    }
+    if (entropy == Entropy::Cm) {
+        return cm::encodeStream(symbols.data(), symbols.size(), usedAlphabet(symbols));
+    }
+    return huff::encodeHuffmanStreamBlocked(symbols.data(), symbols.size(), usedAlphabet(symbols), 15);
+}
+
+// La cantidad de símbolos viene de la cabecera sin verificar: se acota antes de reservar
+static size_t checkedCount(size_t count, size_t max_symbols) {
+    if (count > max_symbols) throw std::runtime_error("lz77_tokens: más símbolos que bytes de salida (datos corruptos)");
+    return count;
+}
+
+// Lee un stream Huffman, FSE o CM precedido por su tamaño en u32; como mucho max_symbols
+template <typename Sym>
+static std::vector<Sym> readSection(const uint8_t*& p, const uint8_t* end, size_t max_symbols) {
+    if (end - p < 4) throw std::runtime_error("lz77_tokens: payload truncado");
+    uint32_t size = getU32(p);
+    p += 4;
+    if ((size_t)(end - p) < size) throw std::runtime_error("lz77_tokens: payload truncado");
+    std::vector<Sym> syms;
+    if (fse::isFseStream(p, size)) {
+        syms.resize(checkedCount(fse::decodedSymbolCount(p, size), max_symbols));
+        fse::decodeStreamInto(p, size, syms.data(), syms.size());
+    } else if (cm::isCmStream(p, size)) {
+        syms.resize(checkedCount(cm::decodedSymbolCount(p, size), max_symbols));
+        cm::decodeStreamInto(p, size, syms.data(), syms.size());
+    } else {
+        syms.resize(checkedCount(huff::decodedSymbolCount(p, size), max_symbols));
+        huff::decodeHuffmanStreamInto(p, size, syms.data(), syms.size());
+    }
+    p += size;
+    return syms;
+}
+
+// ---------- API ----------
+
+std::vector<uint8_t> encode(const uint8_t* lz77, size_t size, LZ77::Format format, Entropy entropy) {
+    const auto tokens = LZ77::tokenize(lz77, size, format);
+
+    // literal/longitud entra en 16 bits y las distancias en 8
+    std::vector<uint16_t> litlen;
+    std::vector<uint8_t> dists;
+    huff::BitWriter extra_bits;
+    litlen.reserve(tokens.size());
+
+    for (const auto& t : tokens) {
+        if (t.length == 0) {
+            litlen.push_back((uint16_t)t.position);
+            continue;
+        }
+        int nbits;
+        uint32_t extra;
+        uint32_t lcode = valueCode((uint32_t)t.length - LZ77::MIN_MATCH_LEN, nbits, extra);
+        litlen.push_back((uint16_t)(256 + lcode));
+        extra_bits.writeBits(extra, nbits);
+
+        uint32_t dcode = valueCode(t.position - 1, nbits, extra);
+        dists.push_back((uint8_t)dcode);
+        extra_bits.writeBits(extra, nbits);
+    }
+    extra_bits.flushZeroPadding();
+
+    // Cada alfabeto se recorta al mayor símbolo usado: en archivos chicos las tablas
+    // de longitudes de código pesan más que los datos. Los streams grandes van en 4
+    // bitstreams intercalados y, pasado un bloque, con una tabla por bloque.
+    auto litlen_stream = encodeSection(litlen, entropy);
+    auto dist_stream = encodeSection(dists, entropy);
+
+    std::vector<uint8_t> out;
+    out.reserve(8 + litlen_stream.size() + dist_stream.size() + extra_bits.data().size());
+    putU32(out, (uint32_t)litlen_stream.size());
+    out.insert(out.end(), litlen_stream.begin(), litlen_stream.end());
+    putU32(out, (uint32_t)dist_stream.size());
+    out.insert(out.end(), dist_stream.begin(), dist_stream.end());
+    out.insert(out.end(), extra_bits.data().begin(), extra_bits.data().end());
+    return out;
+}
+
+size_t decodeInto(const uint8_t* data, size_t size,
+                  uint8_t* out, size_t out_size, size_t dict_size) {
+    const uint8_t* p = data;
+    const uint8_t* const end = data + size;
+    // Cada literal/longitud produce al menos un byte y cada distancia al menos MIN_MATCH_LEN
+    const auto litlen = readSection<uint16_t>(p, end, out_size);
+    const auto dists = readSection<uint8_t>(p, end, out_size / LZ77::MIN_MATCH_LEN);
+    huff::BitReader extra_bits(p, (size_t)(end - p));
+
+    uint8_t* op = out;
+    uint8_t* const oend = out + out_size;
+    size_t next_dist = 0;
+
+    for (uint32_t sym : litlen) {
+        if (sym < 256) {
+            if (op >= oend) throw std::runtime_error("lz77_tokens: la salida no cabe en el buffer");
+            *op++ = (uint8_t)sym;
+            continue;
+        }
+        if (sym >= LITLEN_ALPHABET || next_dist >= dists.size() || dists[next_dist] >= DISTANCE_CODES) {
+            throw std::runtime_error("lz77_tokens: token inválido");
+        }
+        int nbits;
+        size_t length = codeBase(sym - 256, nbits) + LZ77::MIN_MATCH_LEN;
+        if (nbits) length += extra_bits.readBits(nbits);
+
+        size_t distance = codeBase(dists[next_dist++], nbits) + 1;
+        if (nbits) distance += extra_bits.readBits(nbits);
+
+        LZ77::copyMatch(out, op, oend, dict_size, distance, length);
+    }
+    if (next_dist != dists.size()) throw std::runtime_error("lz77_tokens: distancias sobrantes");
+
+    return (size_t)(op - out);
+}
+
+} // namespace lz77_tokens
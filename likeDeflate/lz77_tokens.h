@@ -0,0 +1,53 @@
+#ifndef LZ77_TOKENS_H
+#define LZ77_TOKENS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "lz77.h"
+
+// Codificación de tokens estilo DEFLATE para la salida de LZ77.
+//
+// En vez de pasarle a Huffman el stream de bytes de LZ77 (donde marcadores, longitudes
+// y distancias se mezclan con los literales), los tokens se separan en:
+//   - alfabeto literal/longitud: 0..255 literales, 256.. códigos de longitud
+//   - alfabeto de distancias: un código por cada medio orden de magnitud
+//   - bits extra de longitudes y distancias, sin comprimir
+// Cada alfabeto tiene su propio Huffman, así que un literal >= 0x80 es un solo símbolo
+// y las distancias no ensucian la estadística de los literales.
+//
+// Códigos de valor (longitud - 3 o distancia - 1), como las distancias de DEFLATE:
+//   v < 4          -> código v, sin bits extra
+//   v en [2^n, 2^(n+1)) -> código 2n + (bit n-1 de v), con n-1 bits extra
+//
+// Formato del payload:
+//   [u32 tamaño][literal/longitud][u32 tamaño][distancias][bits extra LSB-first]
+// Cada sección es un stream de huffman.h, fse.h o cm.h; la cabecera del stream dice cuál,
+// así que el decoder no necesita saber con qué backend se comprimió.
+
+namespace lz77_tokens {
+
+constexpr uint32_t LENGTH_CODES     = 32;                  // longitudes 3..65535
+constexpr uint32_t DISTANCE_CODES   = 62;                  // distancias 1..2^31
+constexpr uint32_t LITLEN_ALPHABET  = 256 + LENGTH_CODES;
+
+// Codificador de entropía de las secciones
+enum class Entropy {
+    Huffman,   // huff::encodeHuffmanStreamBlocked
+    Fse,       // fse::encodeStream (tANS)
+    Cm         // cm::encodeStream (aritmético con contextos de orden 1/2, modo max)
+};
+
+// Codifica un stream LZ77 (bytes en el formato dado) como tokens separados
+std::vector<uint8_t> encode(const uint8_t* lz77, size_t size,
+                            LZ77::Format format = LZ77::Format::Classic,
+                            Entropy entropy = Entropy::Huffman);
+
+// Decodifica el payload directo a out (out_size bytes, con dict_size bytes de historia
+// antes de out, igual que LZ77::decompressInto). Devuelve los bytes escritos.
+size_t decodeInto(const uint8_t* data, size_t size,
+                  uint8_t* out, size_t out_size, size_t dict_size = 0);
+
+} // namespace lz77_tokens
+
+#endif
@@ -8,11 +8,15 @@
 #include <iomanip>
 #include <stdexcept>
 #include <filesystem>
+#include <cstring>
+#include <algorithm>
 namespace fs = std::filesystem;
 
 #include "lz77.h"    // tu implementación (LZ77::compress / decompress que devuelven vector)
 #include "huffman.h" // namespace huff, con encodeHuffmanStream / decodeHuffmanStream
 #include "chupy_header.h"
+#include "deflate_interface.h"
+#include "deflate_stream.h"
 
 using namespace huff;
 
@@ -64,73 +68,214 @@ static void print_stats(std::size_t orig,
 
 }
 
-// ------------------------- compresión -------------------------
+// ------------------------- streaming -------------------------
+
+// Tamaño de cada lectura en los caminos por streaming
+static constexpr size_t IO_CHUNK = 1 << 20;
 
-static void do_compress(const std::string &inPath, const std::string &outPath)
+// Lee el stream por trozos de IO_CHUNK y se los pasa a fn (memoria constante)
+template <typename Fn>
+static void forEachChunk(std::istream &in, Fn fn)
 {
-    // 1) Leer original
-    auto input = readFile(inPath);
-    
-    // Extraer la extensión original
-    fs::path p(inPath);
-    std::string original_ext = p.extension().string();
+    std::vector<uint8_t> buf(IO_CHUNK);
+    while (in)
+    {
+        in.read(reinterpret_cast<char *>(buf.data()), (std::streamsize)buf.size());
+        std::streamsize got = in.gcount();
+        if (got <= 0)
+            break;
+        fn(buf.data(), (size_t)got);
+    }
+}
+
+// Descomprime un .chupy con frames y lo compara contra el original, ambos por streaming
+static bool verifyFramedFile(const std::string &originalPath, const std::string &chupyPath, uint16_t version)
+{
+    try {
+        std::ifstream original(originalPath, std::ios::binary);
+        std::ifstream packed(chupyPath, std::ios::binary);
+        if (!original || !packed)
+            return false;
 
-    //LZ77
-    std::vector<uint8_t> lz77_bytes = LZ77::compress(input);
+        bool equal = true;
+        std::vector<uint8_t> expected;
+        auto compare = [&](const uint8_t *data, size_t size) {
+            expected.resize(size);
+            original.read(reinterpret_cast<char *>(expected.data()), (std::streamsize)size);
+            if ((size_t)original.gcount() != size || std::memcmp(expected.data(), data, size) != 0)
+                equal = false;
+        };
 
-    // Huffman sobre stream LZ77 
-    std::vector<uint32_t> syms(lz77_bytes.begin(), lz77_bytes.end());
-    auto huff_blob = encodeHuffmanStream(syms, /*alphabetSize=*/256, /*maxCodeLen=*/15);
+        if (version == chupy::VERSION_INDEPENDENT) {
+            packed.seekg(0, std::ios::end);
+            const uint64_t end = (uint64_t)packed.tellg();
+            deflate_stream::decompressFramed(packed, sizeof(chupy::ChupyHeader), end, compare);
+        } else {
+            packed.seekg(sizeof(chupy::ChupyHeader));
+            deflate_stream::StreamDecompressor decompressor;
+            decompressor.begin(compare);
+            forEachChunk(packed, [&](const uint8_t *data, size_t size) { decompressor.feed(data, size); });
+            decompressor.finish();
+        }
 
-    // 4) Crear archivo .chupy con header (SOLO extensión)
-    auto final_output = chupy::createChupyFile(
-        original_ext,
-        huff_blob
-    );
+        return equal && original.peek() == std::char_traits<char>::eof();
+    } catch (const std::exception &) {
+        return false;
+    }
+}
 
-    // Escribir .chupy
-    writeFile(outPath, final_output);
+// ------------------------- compresión -------------------------
 
-    // Verificación rápida en memoria + stats - CAMBIO: llamada estática directa
-    auto back_syms = decodeHuffmanStream(huff_blob.data(), huff_blob.size());
-    std::vector<uint8_t> lz77_back(back_syms.begin(), back_syms.end());
+static void do_compress(const std::string &inPath, const std::string &outPath,
+                        const OpcionesCompresion &opciones = OpcionesCompresion())
+{
+    // 1) Abrir original (se lee por trozos, nunca completo)
+    std::ifstream in(inPath, std::ios::binary);
+    if (!in)
+        throw std::runtime_error("No pude abrir: " + inPath);
+    std::ofstream out(outPath, std::ios::binary);
+    if (!out)
+        throw std::runtime_error("No pude crear: " + outPath);
 
-    std::vector<uint8_t> restored = LZ77::decompress(lz77_back);
+    // 2) Header .chupy con la extensión original. Con ventana larga los frames se
+    // encadenan (v2) para no perder las repeticiones lejanas; si no, son independientes
+    // (v3) y se comprimen y descomprimen en paralelo.
+    const bool chained = opciones.ventanaMiB > 0;
+    chupy::ChupyHeader header;
+    header.version = chained ? chupy::VERSION_FRAMES : chupy::VERSION_INDEPENDENT;
+    header.setExtension(fs::path(inPath).extension().string());
+    auto header_bytes = header.serialize();
+    out.write(reinterpret_cast<const char *>(header_bytes.data()), (std::streamsize)header_bytes.size());
 
-    if (restored != input) {
-        std::cerr << "La verificación de integridad falló\n";
+    // 3) LZ77 + Huffman por frames; cada frame se escribe apenas está listo
+    auto write = [&](const uint8_t *data, size_t size) {
+        out.write(reinterpret_cast<const char *>(data), (std::streamsize)size);
+    };
+    uint64_t bytes_in, lz77_bytes, bytes_out;
+    if (chained) {
+        deflate_stream::StreamCompressor compressor(opcionesLZ77(opciones), deflate_stream::DEFAULT_CHUNK_SIZE,
+                                                    opciones.codificacion, opciones.entropia);
+        compressor.begin(write);
+        forEachChunk(in, [&](const uint8_t *data, size_t size) { compressor.feed(data, size); });
+        compressor.finish();
+        bytes_in = compressor.bytesIn();
+        lz77_bytes = compressor.lz77Bytes();
+        bytes_out = compressor.bytesOut();
+    } else {
+        deflate_stream::FramedCompressor compressor(opcionesLZ77(opciones), deflate_stream::INDEPENDENT_FRAME_SIZE,
+                                                    opciones.codificacion, opciones.entropia);
+        compressor.begin(write);
+        forEachChunk(in, [&](const uint8_t *data, size_t size) { compressor.feed(data, size); });
+        compressor.finish();
+        bytes_in = compressor.bytesIn();
+        lz77_bytes = compressor.lz77Bytes();
+        bytes_out = compressor.bytesOut();
     }
 
-    print_stats(input.size(), lz77_bytes.size(), final_output.size(), restored.size());
+    out.close();
+    if (!out)
+        throw std::runtime_error("Error escribiendo: " + outPath);
+
+    // 4) Cada frame lleva su CRC32C y se verifica al descomprimir; la ida y vuelta
+    // completa (por streaming) solo con --paranoid porque cuesta otra descompresión
+    // Si falla, el .chupy no sirve: se borra y la operación termina con error
+    if (opciones.paranoico && !verifyFramedFile(inPath, outPath, header.version)) {
+        std::error_code ec;
+        fs::remove(outPath, ec);
+        throw std::runtime_error("La verificación de integridad falló; se borró " + outPath);
+    }
+
+    print_stats(bytes_in, lz77_bytes, header_bytes.size() + bytes_out, bytes_in);
 }
 
 // ------------------------- descompresión -------------------------
 
-static void do_decompress(const std::string &inPath, const std::string &outPath)
+// Formato v1: un único stream Huffman, se decodifica todo en memoria
+static size_t decompressSimple(const std::string &inPath, const std::string &outPath)
 {
     auto blob = readFile(inPath);
     std::cout << "Leídos " << blob.size() << " bytes de " << inPath << "\n";
-    
-    // Leer y validar archivo .chupy
+
     auto chupy_file = chupy::readChupyFile(blob);
-    
     if (!chupy_file.valid) {
         throw std::runtime_error("Archivo no es un .chupy válido");
     }
-    
-    const auto& header = chupy_file.header;
-    
-    
+
     // Decodificar Huffman
-    auto syms = decodeHuffmanStream(
-        chupy_file.compressed_data.data(),
-        chupy_file.compressed_data.size()
-    );
-    std::vector<uint8_t> lz77_bytes(syms.begin(), syms.end());
+    const auto &compressed = chupy_file.compressed_data;
+    std::vector<uint8_t> lz77_bytes(decodedSymbolCount(compressed.data(), compressed.size()));
+    decodeHuffmanStreamInto(compressed.data(), compressed.size(), lz77_bytes.data(), lz77_bytes.size());
     std::cout << "Huffman decodificó " << lz77_bytes.size() << " bytes\n";
 
-    // Descomprimir LZ77 - CAMBIO: llamada estática directa
+    // Descomprimir LZ77
     std::vector<uint8_t> restored = LZ77::decompress(lz77_bytes);
+    writeFile(outPath, restored);
+    return restored.size();
+}
+
+// Formato v2: frames, se decodifica y escribe frame a frame con memoria constante
+static size_t decompressFrames(std::istream &in, const std::string &outPath)
+{
+    std::ofstream out(outPath, std::ios::binary);
+    if (!out)
+        throw std::runtime_error("No pude crear: " + outPath);
+
+    deflate_stream::StreamDecompressor decompressor;
+    decompressor.begin([&](const uint8_t *data, size_t size) {
+        out.write(reinterpret_cast<const char *>(data), (std::streamsize)size);
+    });
+    forEachChunk(in, [&](const uint8_t *data, size_t size) { decompressor.feed(data, size); });
+    decompressor.finish();
+
+    out.close();
+    if (!out)
+        throw std::runtime_error("Error escribiendo: " + outPath);
+    return (size_t)decompressor.bytesOut();
+}
+
+// Formato v3: frames independientes; se ubican con el índice y se decodifican en paralelo
+static size_t decompressIndependent(std::istream &in, const std::string &outPath)
+{
+    std::ofstream out(outPath, std::ios::binary);
+    if (!out)
+        throw std::runtime_error("No pude crear: " + outPath);
+
+    in.seekg(0, std::ios::end);
+    const uint64_t end = (uint64_t)in.tellg();
+    const uint64_t restored = deflate_stream::decompressFramed(
+        in, sizeof(chupy::ChupyHeader), end, [&](const uint8_t *data, size_t size) {
+            out.write(reinterpret_cast<const char *>(data), (std::streamsize)size);
+        });
+
+    out.close();
+    if (!out)
+        throw std::runtime_error("Error escribiendo: " + outPath);
+    return (size_t)restored;
+}
+
+// Lee y valida el header .chupy; deja in posicionado al inicio del body
+static chupy::ChupyHeader readHeader(std::istream &in)
+{
+    std::vector<uint8_t> header_bytes(sizeof(chupy::ChupyHeader));
+    in.read(reinterpret_cast<char *>(header_bytes.data()), (std::streamsize)header_bytes.size());
+    if ((size_t)in.gcount() != header_bytes.size()) {
+        throw std::runtime_error("Archivo no es un .chupy válido");
+    }
+    const auto header = chupy::ChupyHeader::deserialize(header_bytes.data());
+    if (!header.isValid()) {
+        throw std::runtime_error("Archivo no es un .chupy válido");
+    }
+    return header;
+}
+
+static void do_decompress(const std::string &inPath, const std::string &outPath)
+{
+    std::ifstream in(inPath, std::ios::binary);
+    if (!in)
+        throw std::runtime_error("No pude abrir: " + inPath);
+
+    // Leer y validar header .chupy
+    const auto header = readHeader(in);
 
     // Determinar nombre de salida automático
     std::string final_output_path = outPath;
@@ -147,23 +292,90 @@ static void do_decompress(const std::string &inPath, const std::string &outPath)
         }
     }
     
-    // Escribir archivo restaurado
-    writeFile(final_output_path, restored);
-    std::cout << "Restaurado en " << final_output_path << " (" << restored.size() << " bytes)\n";
+    size_t restored;
+    if (header.version == chupy::VERSION_SIMPLE)
+        restored = decompressSimple(inPath, final_output_path);
+    else if (header.version == chupy::VERSION_FRAMES)
+        restored = decompressFrames(in, final_output_path);
+    else
+        restored = decompressIndependent(in, final_output_path);
+
+    std::cout << "Restaurado en " << final_output_path << " (" << restored << " bytes)\n";
     std::cout << "✓ Descompresión completada\n";
 }
 
+// ------------------------- acceso por rango -------------------------
+
+// Bytes [offset, offset + length) del original. v3 usa el índice y solo decodifica los
+// frames del rango; v1 y v2 no tienen índice y se decodifican desde el inicio hasta
+// cubrir el rango.
+static std::vector<uint8_t> read_range(const std::string &inPath, uint64_t offset, uint64_t length)
+{
+    std::ifstream in(inPath, std::ios::binary);
+    if (!in)
+        throw std::runtime_error("No pude abrir: " + inPath);
+    const auto header = readHeader(in);
+
+    if (header.version == chupy::VERSION_INDEPENDENT) {
+        in.seekg(0, std::ios::end);
+        const uint64_t end = (uint64_t)in.tellg();
+        return deflate_stream::decompressRange(in, sizeof(chupy::ChupyHeader), end, offset, length);
+    }
+
+    std::vector<uint8_t> result;
+    const uint64_t end = offset + std::min(length, UINT64_MAX - offset);
+    uint64_t pos = 0;
+    auto keep = [&](const uint8_t *data, size_t size) {
+        const uint64_t from = std::max(pos, offset);
+        const uint64_t to = std::min(pos + size, end);
+        if (from < to)
+            result.insert(result.end(), data + (from - pos), data + (to - pos));
+        pos += size;
+    };
+
+    if (header.version == chupy::VERSION_SIMPLE) {
+        in.close();
+        auto chupy_file = chupy::readChupyFile(readFile(inPath));
+        if (!chupy_file.valid)
+            throw std::runtime_error("Archivo no es un .chupy válido");
+        const auto &compressed = chupy_file.compressed_data;
+        std::vector<uint8_t> lz77_bytes(decodedSymbolCount(compressed.data(), compressed.size()));
+        decodeHuffmanStreamInto(compressed.data(), compressed.size(), lz77_bytes.data(), lz77_bytes.size());
+        const auto restored = LZ77::decompress(lz77_bytes);
+        keep(restored.data(), restored.size());
+        return result;
+    }
+
+    deflate_stream::StreamDecompressor decompressor;
+    decompressor.begin(keep);
+    std::vector<uint8_t> buf(IO_CHUNK);
+    while (pos < end && !decompressor.done() && in) {
+        in.read(reinterpret_cast<char *>(buf.data()), (std::streamsize)buf.size());
+        if (in.gcount() <= 0)
+            break;
+        decompressor.feed(buf.data(), (size_t)in.gcount());
+    }
+    if (pos < end)
+        decompressor.finish();  // lanza si el stream quedó truncado antes del rango
+    return result;
+}
+
 // ------------------------- interfaz pública temporal  -------------------------
 
-void comprimirConDeflate(const std::string& archivoEntrada, const std::string& archivoSalida) {
+void comprimirConDeflate(const std::string& archivoEntrada, const std::string& archivoSalida,
+                         const OpcionesCompresion& opciones) {
     const std::string salidaFinal = fs::path(archivoSalida).replace_extension(".chupy").string();
-    do_compress(archivoEntrada, salidaFinal);
+    do_compress(archivoEntrada, salidaFinal, opciones);
 }
 
 void descomprimirConDeflate(const std::string& archivoEntrada, const std::string& archivoSalida) {
     do_decompress(archivoEntrada, archivoSalida);
 }
 
+std::vector<uint8_t> leerRangoDeflate(const std::string& archivoEntrada, uint64_t offset, uint64_t longitud) {
+    return read_range(archivoEntrada, offset, longitud);
+}
+
 // ------------------------- menú principal -------------------------
 //mientras para que permita tener 2 mains
 int menu_standalone()   